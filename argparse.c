@@ -7,369 +7,3365 @@
 #                                                                              #
 ##############################################################################*/
 
+#define _GNU_SOURCE /* strtod_l */
 #include "argparse.h"
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <locale.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) &&         \
+    !defined(ARGPARSER_NO_SIMD)
+#define ARGPARSER_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/* Timers imply counters */
+#if defined(ARGPARSER_STATS_TIMERS) && !defined(ARGPARSER_STATS)
+#define ARGPARSER_STATS
+#endif
+
+/* Add n to a counter of stats, which may be NULL */
+#ifdef ARGPARSER_STATS
+#define ARGPARSER_COUNT(stats, counter, n)                                     \
+    ((stats) ? (void)((stats)->counter += (n)) : (void)0)
+#else
+#define ARGPARSER_COUNT(stats, counter, n) ((void)(stats))
+#endif
+
+/* Start a timer, and add the ticks since start to a counter of stats */
+#ifdef ARGPARSER_STATS_TIMERS
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define ARGPARSER_TICKS() ((uint64_t)__rdtsc())
+#else
+#include <time.h>
+static uint64_t Argparser_ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#define ARGPARSER_TICKS() Argparser_ticks()
+#endif
+#define ARGPARSER_TIMER(start) const uint64_t start = ARGPARSER_TICKS()
+#define ARGPARSER_ELAPSED(stats, counter, start)                               \
+    ((stats)->counter += ARGPARSER_TICKS() - (start))
+#else
+#define ARGPARSER_TIMER(start) ((void)0)
+#define ARGPARSER_ELAPSED(stats, counter, start) ((void)0)
+#endif
+
+/* A long option name in the pool, with its hash and the option index plus
+ * one, which is 0 for an empty slot */
+struct ArgparseLongSlot {
+    uint32_t hash, len, offset, opt;
+};
+
+/* Lookup tables over parser->opts; slots hold an option index plus one, so
+ * that zero marks an empty slot */
+struct ArgparseIndex {
+    uint32_t short_slots[256];
+    size_t long_mask;
+    /* Distinct long option names, packed one after another and each
+     * '\0'-terminated, so lookups need not touch the options */
+    char *pool;
+    /* The same names in strcmp order, for prefix queries */
+    struct ArgparseName *names;
+    size_t num_names;
+    struct ArgparseLongSlot long_slots[];
+};
+
+/* A long option name with the index of its option */
+struct ArgparseName {
+    const char *name;
+    uint32_t opt;
+};
+
+/* A mapped response file */
+struct ArgparseMapping {
+    void *addr;
+    size_t len;
+};
+
+/* Storage for tokens split across Argparser_feed_buffer chunks */
+struct ArgparseBlock {
+    struct ArgparseBlock *next;
+    size_t size, used;
+    char data[];
+};
+
+static void *Argparser_realloc(const ArgparseAllocator *const allocator,
+                               void *const ptr, const size_t old_size,
+                               const size_t new_size) {
+    if (!allocator)
+        return realloc(ptr, new_size);
+    return allocator->reallocate(allocator->ctx, ptr, old_size, new_size);
+}
+
+static void *Argparser_alloc(const ArgparseAllocator *const allocator,
+                             const size_t size) {
+    return Argparser_realloc(allocator, NULL, 0, size);
+}
+
+static void *Argparser_calloc(const ArgparseAllocator *const allocator,
+                              const size_t size) {
+    void *ptr;
+    if (!allocator)
+        return calloc(1, size);
+    if ((ptr = Argparser_alloc(allocator, size)))
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+static void Argparser_free(const ArgparseAllocator *const allocator,
+                           void *const ptr) {
+    if (!allocator)
+        free(ptr);
+    else if (ptr && allocator->release)
+        allocator->release(allocator->ctx, ptr);
+}
+
+/*
+ * Bump allocator over the buffer of Argparser_init_buffer, stored at the start
+ * of that buffer. Only the most recent block can grow in place or be given
+ * back, which covers the arrays that grow while options are added. Results
+ * from Argparser_results_init share the arena, possibly across threads, so it
+ * is locked.
+ */
+typedef struct ArgparseArena {
+    ArgparseAllocator allocator;
+    pthread_mutex_t lock;
+    char *data;
+    size_t size, used, last;
+} ArgparseArena;
+
+#define ARGPARSER_ALIGN _Alignof(max_align_t)
+
+static void *ArgparseArena_bump(ArgparseArena *const arena, void *const ptr,
+                                const size_t old_size, const size_t new_size) {
+    if (ptr && (char *)ptr == arena->data + arena->last) {
+        if (new_size > arena->size - arena->last)
+            return NULL;
+        arena->used = arena->last + new_size;
+        return ptr;
+    }
+
+    /* Align the address, not the offset, as data need not be aligned */
+    const size_t begin =
+        arena->used + (size_t)(-(uintptr_t)(arena->data + arena->used) &
+                               (ARGPARSER_ALIGN - 1));
+    if (begin > arena->size || new_size > arena->size - begin)
+        return NULL;
+    char *const block = arena->data + begin;
+    if (ptr)
+        memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+    arena->last = begin;
+    arena->used = begin + new_size;
+    return block;
+}
+
+static void *ArgparseArena_reallocate(void *const ctx, void *const ptr,
+                                      const size_t old_size,
+                                      const size_t new_size) {
+    ArgparseArena *const arena = ctx;
+    pthread_mutex_lock(&arena->lock);
+    void *const block = ArgparseArena_bump(arena, ptr, old_size, new_size);
+    pthread_mutex_unlock(&arena->lock);
+    return block;
+}
+
+static void ArgparseArena_release(void *const ctx, void *const ptr) {
+    ArgparseArena *const arena = ctx;
+    pthread_mutex_lock(&arena->lock);
+    if ((char *)ptr == arena->data + arena->last)
+        arena->used = arena->last;
+    pthread_mutex_unlock(&arena->lock);
+}
+
+static void Argparser_drop_index(Argparser *const parser) {
+    Argparser_free(parser->allocator, parser->index);
+    parser->index = NULL;
+}
+
+static void ArgparseResults_unmap_files(ArgparseResults *const results) {
+    for (size_t i = 0; i < results->num_mappings; ++i)
+        munmap(results->mappings[i].addr, results->mappings[i].len);
+    results->num_mappings = 0;
+}
+
+/* Free the token blocks, except the most recent one if keep_one */
+static void ArgparseResults_free_blocks(ArgparseResults *const results,
+                                        struct ArgparseBlock **const blocks,
+                                        const int keep_one) {
+    struct ArgparseBlock *block = *blocks;
+    if (keep_one && block) {
+        block->used = 0;
+        block = block->next;
+        (*blocks)->next = NULL;
+    } else {
+        *blocks = NULL;
+    }
+    while (block) {
+        struct ArgparseBlock *next = block->next;
+        Argparser_free(results->allocator, block);
+        block = next;
+    }
+}
+
+/* Release everything but pos_args and states, whose owners differ */
+static void ArgparseResults_release(ArgparseResults *const results) {
+    Argparser_free(results->allocator, results->occurrences);
+    Argparser_free(results->allocator, results->tokens);
+    ArgparseResults_unmap_files(results);
+    Argparser_free(results->allocator, results->mappings);
+    ArgparseResults_free_blocks(results, &results->blocks, 0);
+    ArgparseResults_free_blocks(results, &results->list_blocks, 0);
+}
+
+/* Double the capacity of a growable array, which may be NULL. Returns the new
+ * array, or NULL (leaving array and capacity untouched) on failure. */
+static void *Argparser_grow(const ArgparseAllocator *const allocator,
+                            void *const array, size_t *const capacity,
+                            const size_t elem_size) {
+    const size_t new_capacity =
+        *capacity ? 2 * *capacity : ARGPARSER_INITIAL_CAPACITY;
+    void *new_array = Argparser_realloc(allocator, array, *capacity * elem_size,
+                                        new_capacity * elem_size);
+    if (new_array)
+        *capacity = new_capacity;
+    return new_array;
+}
+
+/* Allocate the pos_args array of results */
+static int ArgparseResults_init_pos_args(ArgparseResults *const results,
+                                         const intmax_t max_pos_args) {
+    results->pos_args_capacity = ARGPARSER_INITIAL_CAPACITY;
+    if (0 <= max_pos_args &&
+        max_pos_args < (intmax_t)results->pos_args_capacity)
+        results->pos_args_capacity = max_pos_args;
+    return !(results->pos_args =
+                 Argparser_alloc(results->allocator,
+                                 results->pos_args_capacity *
+                                     sizeof *results->pos_args));
+}
 
 int Argparser_init(Argparser *const parser, const char *const prog_name,
                    const intmax_t max_pos_args) {
+    return Argparser_init_allocator(parser, prog_name, max_pos_args, NULL);
+}
+
+int Argparser_init_allocator(Argparser *const parser,
+                             const char *const prog_name,
+                             const intmax_t max_pos_args,
+                             const ArgparseAllocator *const allocator) {
     memset(parser, 0, sizeof *parser);
     parser->prog_name = prog_name;
+    parser->owned = 1;
+    Argparser_set_allocator(parser, allocator);
+
+    /* Results are kept apart from the options, see ArgparseResults.states */
+    parser->opts_capacity = ARGPARSER_INITIAL_CAPACITY;
+    if (!(parser->opts = Argparser_alloc(
+              allocator, parser->opts_capacity * sizeof *parser->opts)) ||
+        !(parser->results.states = Argparser_calloc(
+              allocator,
+              parser->opts_capacity * sizeof *parser->results.states)))
+        return 1;
+
+    parser->max_pos_args = max_pos_args;
+    return ArgparseResults_init_pos_args(&parser->results, max_pos_args);
+}
+
+int Argparser_init_buffer(Argparser *const parser, const char *const prog_name,
+                          const intmax_t max_pos_args, void *const buf,
+                          const size_t size) {
+    /* Put the arena itself at the first aligned address */
+    const size_t skip = (size_t)-(uintptr_t)buf & (ARGPARSER_ALIGN - 1);
+    if (size < skip + sizeof(ArgparseArena)) {
+        memset(parser, 0, sizeof *parser);
+        return 1;
+    }
+    ArgparseArena *const arena = (ArgparseArena *)((char *)buf + skip);
+    arena->allocator.reallocate = ArgparseArena_reallocate;
+    arena->allocator.release = ArgparseArena_release;
+    arena->allocator.ctx = arena;
+    if (pthread_mutex_init(&arena->lock, NULL)) {
+        memset(parser, 0, sizeof *parser);
+        return 1;
+    }
+    arena->data = (char *)(arena + 1);
+    arena->size = size - skip - sizeof *arena;
+    arena->used = arena->last = 0;
+    return Argparser_init_allocator(parser, prog_name, max_pos_args,
+                                    &arena->allocator);
+}
+
+void Argparser_set_allocator(Argparser *const parser,
+                             const ArgparseAllocator *const allocator) {
+    parser->allocator = parser->results.allocator = allocator;
+}
+
+static void ArgparseOpt_deinit(const Argparser *const parser,
+                               ArgparseOpt *const opt) {
+    if (!(opt->flags & ARG_FLAG_BORROWED))
+        Argparser_free(parser->allocator, opt->long_opt);
+}
+
+/* Drop the options put aside by Argparser_reset */
+static void Argparser_unload_subcommand(Argparser *const parser) {
+    Argparser_free(parser->allocator, parser->loaded_index);
+    parser->loaded_index = NULL;
+    for (size_t i = parser->num_opts; i < parser->num_loaded_opts; ++i)
+        ArgparseOpt_deinit(parser, parser->opts + i);
+    parser->loaded_subcommand = parser->num_loaded_opts = 0;
+}
+
+void Argparser_deinit(Argparser *const parser) {
+    Argparser_unload_subcommand(parser);
+    Argparser_drop_index(parser);
+    Argparser_free(parser->allocator, parser->global_index);
+    Argparser_set_cache(parser, 0);
+    ArgparseResults_release(&parser->results);
+    Argparser_free(parser->allocator, parser->subcommands);
+    Argparser_free(parser->allocator, parser->subcommand_slots);
+    if (parser->owns_states) {
+        Argparser_free(parser->allocator, parser->results.states);
+        parser->results.states = NULL;
+        parser->owns_states = 0;
+    }
+    if (!parser->owned)
+        return;
+    Argparser_free(parser->allocator, parser->results.pos_args);
+    Argparser_free(parser->allocator, parser->results.states);
+    for (size_t i = 0; i < parser->num_opts; ++i)
+        ArgparseOpt_deinit(parser, parser->opts + i);
+    Argparser_free(parser->allocator, parser->opts);
+    if (parser->allocator &&
+        parser->allocator->reallocate == ArgparseArena_reallocate)
+        pthread_mutex_destroy(&((ArgparseArena *)parser->allocator->ctx)->lock);
+}
+
+/* Allocate the states of an Argparser_struct parser set up without them */
+static int Argparser_alloc_states(Argparser *const parser) {
+    if (parser->results.states)
+        return 0;
+    if (!(parser->results.states = Argparser_calloc(
+              parser->allocator,
+              (parser->opts_capacity + 1) * sizeof *parser->results.states)))
+        return 1;
+    parser->owns_states = 1;
+    return 0;
+}
+
+int Argparser_add_argument(Argparser *const parser, const char short_opt,
+                           const char *const long_opt,
+                           const ArgparseType type) {
+    return Argparser_add_argument_flags(parser, short_opt, long_opt, type, 0);
+}
+
+int Argparser_add_argument_flags(Argparser *const parser, const char short_opt,
+                                 const char *const long_opt,
+                                 const ArgparseType type,
+                                 const unsigned flags) {
+    return Argparser_add_argument_dest(parser, short_opt, long_opt, type, flags,
+                                       NULL);
+}
+
+int Argparser_add_argument_dest(Argparser *const parser, const char short_opt,
+                                const char *const long_opt,
+                                const ArgparseType type, const unsigned flags,
+                                void *const dest) {
+    /* The index is rebuilt on the next parse. Cached results go stale,
+     * unless a subcommand adds the option, as it does on every parse. */
+    Argparser_drop_index(parser);
+    if (!parser->results.subcommand) {
+        Argparser_unload_subcommand(parser);
+        Argparser_clear_cache(parser);
+    }
+
+    /* Grow the opts array, and the states with it */
+    if (Argparser_alloc_states(parser))
+        return 1;
+    if (parser->num_opts >= parser->opts_capacity) {
+        const size_t old_capacity = parser->opts_capacity;
+        size_t capacity = old_capacity;
+        ArgparseOpt *new_opts;
+        ArgparseOptState *new_states;
+        ARGPARSER_COUNT(&parser->results.stats, opts_reallocs, 1);
+        if (!(new_opts = Argparser_grow(parser->allocator, parser->opts,
+                                        &capacity, sizeof *parser->opts)))
+            return 1;
+        parser->opts = new_opts;
+        if (!(new_states = Argparser_realloc(
+                  parser->allocator, parser->results.states,
+                  old_capacity * sizeof *new_states,
+                  capacity * sizeof *new_states)))
+            return 1;
+        memset(new_states + old_capacity, 0,
+               (capacity - old_capacity) * sizeof *new_states);
+        parser->results.states = new_states;
+        parser->opts_capacity = capacity;
+    }
+
+    ArgparseOpt *opt = parser->opts + (parser->num_opts++);
+    memset(opt, 0, sizeof *opt);
+    opt->short_opt = short_opt;
+    opt->type = type;
+    opt->flags = flags;
+    opt->dest = dest;
+    if (parser->flags & ARGPARSER_BORROW_NAMES)
+        opt->flags |= ARG_FLAG_BORROWED;
+    if (long_opt && (opt->flags & ARG_FLAG_BORROWED)) {
+        opt->long_opt = (char *)long_opt;
+    } else if (long_opt) {
+        const size_t len = strlen(long_opt);
+        if (!(opt->long_opt = Argparser_alloc(parser->allocator, len + 1))) {
+            /* Don't let Argparser_deinit free a NULL name */
+            --parser->num_opts;
+            return 1;
+        }
+        memcpy(opt->long_opt, long_opt, len + 1);
+    }
+    return 0;
+}
+
+/* FNV-1a over a name that need not be NULL-terminated */
+static uint32_t Argparser_hash(const char *const name, const size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i)
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    return hash;
+}
+
+/* Whether the NULL-terminated long_opt equals the first len chars of name */
+static int Argparser_long_opt_eq(const char *const long_opt,
+                                 const char *const name, const size_t len) {
+    return long_opt && strncmp(long_opt, name, len) == 0 &&
+           long_opt[len] == '\0';
+}
+
+int Argparser_add_subcommand(Argparser *const parser, const char *const name,
+                             const ArgparseSubcommandInit init,
+                             void *const data) {
+    /* Options are added to the parser when a subcommand is selected */
+    if (!parser->owned || parser->num_subcommands >= UINT32_MAX)
+        return 1;
+
+    /* The hash table is rebuilt on the next dispatch */
+    Argparser_free(parser->allocator, parser->subcommand_slots);
+    parser->subcommand_slots = NULL;
+    if (!parser->results.subcommand)
+        Argparser_clear_cache(parser);
+
+    /* Grow the subcommands array if needed */
+    if (parser->num_subcommands >= parser->subcommands_capacity) {
+        ArgparseSubcommand *new_subcommands;
+        if (!(new_subcommands = Argparser_grow(
+                  parser->allocator, parser->subcommands,
+                  &parser->subcommands_capacity, sizeof *parser->subcommands)))
+            return 1;
+        parser->subcommands = new_subcommands;
+    }
+
+    ArgparseSubcommand *subcommand =
+        parser->subcommands + parser->num_subcommands++;
+    subcommand->name = name;
+    subcommand->init = init;
+    subcommand->data = data;
+    return 0;
+}
+
+/* Build the hash table over subcommand names, at most half full. Failure is
+ * not fatal, lookups then fall back to a linear scan. */
+static void Argparser_build_subcommand_slots(Argparser *const parser) {
+    size_t num_slots = 1;
+    while (num_slots < 2 * parser->num_subcommands)
+        num_slots *= 2;
+    if (!(parser->subcommand_slots = Argparser_calloc(
+              parser->allocator, num_slots * sizeof *parser->subcommand_slots)))
+        return;
+    parser->subcommand_mask = num_slots - 1;
+
+    /* On duplicate names the first one wins, as with the linear scan */
+    for (size_t i = 0; i < parser->num_subcommands; ++i) {
+        const char *const name = parser->subcommands[i].name;
+        size_t slot = Argparser_hash(name, strlen(name)) &
+                      parser->subcommand_mask;
+        while (parser->subcommand_slots[slot] &&
+               strcmp(parser->subcommands[parser->subcommand_slots[slot] - 1]
+                          .name,
+                      name) != 0)
+            slot = (slot + 1) & parser->subcommand_mask;
+        if (!parser->subcommand_slots[slot])
+            parser->subcommand_slots[slot] = (uint32_t)i + 1;
+    }
+}
+
+/* Get the index of the subcommand called by the first len chars of name,
+ * otherwise num_subcommands */
+static size_t Argparser_find_subcommand(const Argparser *const parser,
+                                        const char *const name,
+                                        const size_t len) {
+    if (parser->subcommand_slots) {
+        size_t slot = Argparser_hash(name, len) & parser->subcommand_mask;
+        for (uint32_t i; (i = parser->subcommand_slots[slot]);
+             slot = (slot + 1) & parser->subcommand_mask)
+            if (Argparser_long_opt_eq(parser->subcommands[i - 1].name, name,
+                                      len))
+                return i - 1;
+        return parser->num_subcommands;
+    }
+    size_t i = 0;
+    while (i < parser->num_subcommands &&
+           !Argparser_long_opt_eq(parser->subcommands[i].name, name, len))
+        ++i;
+    return i;
+}
+
+/* Drop the options added by the selected subcommand */
+static void Argparser_drop_subcommand_opts(Argparser *const parser) {
+    Argparser_drop_index(parser);
+    parser->index = parser->global_index;
+    parser->global_index = NULL;
+    while (parser->num_opts > parser->num_global_opts)
+        ArgparseOpt_deinit(parser, parser->opts + --parser->num_opts);
+}
+
+/* Put the options of the selected subcommand aside after num_opts, with the
+ * index over all options, until it is selected again */
+static void Argparser_hide_subcommand_opts(Argparser *const parser) {
+    parser->num_loaded_opts = parser->num_opts;
+    parser->num_opts = parser->num_global_opts;
+    parser->loaded_index = parser->index;
+    parser->index = parser->global_index;
+    parser->global_index = NULL;
+}
+
+/* Order names by strcmp */
+static int Argparser_name_cmp(const void *const a, const void *const b) {
+    const struct ArgparseName *const x = a, *const y = b;
+    return strcmp(x->name, y->name);
+}
+
+/*
+ * Build the lookup index, if the parser is large enough to need one or the
+ * caller insists. It keeps the lookup keys apart from the options: short
+ * options in a table indexed by char, and long names with their hashes and
+ * lengths in open addressing slots over a packed pool of the names. Failure
+ * is not fatal, lookups then fall back to linear scans. A lookup hook still
+ * answers lookups, so its parsers only need the sorted names for prefix
+ * queries, and get them when frozen or accepting abbreviations.
+ */
+static int Argparser_build_index(Argparser *const parser, const int always) {
+    if (parser->index || parser->num_opts >= UINT32_MAX ||
+        (!always && (parser->num_opts < ARGPARSER_INDEX_THRESHOLD ||
+                     (parser->lookup &&
+                      !(parser->flags & ARGPARSER_ABBREVIATIONS)))))
+        return 0;
+
+    size_t pool_size = 0;
+    for (size_t i = 0; i < parser->num_opts; ++i)
+        if (parser->opts[i].long_opt)
+            pool_size += strlen(parser->opts[i].long_opt) + 1;
+    if (pool_size > UINT32_MAX)
+        return 0;
+
+    /* Keep the load factor of the long option table at most 1/2. The sorted
+     * names and the pool follow it in the same allocation. */
+    size_t num_long_slots = 1;
+    while (num_long_slots < 2 * parser->num_opts)
+        num_long_slots *= 2;
+    const size_t names_offset =
+        (sizeof(struct ArgparseIndex) +
+         num_long_slots * sizeof(struct ArgparseLongSlot) +
+         _Alignof(struct ArgparseName) - 1) &
+        ~(_Alignof(struct ArgparseName) - 1);
+    const size_t pool_offset =
+        names_offset + parser->num_opts * sizeof(struct ArgparseName);
+    struct ArgparseIndex *index =
+        Argparser_calloc(parser->allocator, pool_offset + pool_size);
+    if (!index)
+        return 1;
+    index->long_mask = num_long_slots - 1;
+    index->names = (struct ArgparseName *)((char *)index + names_offset);
+    index->pool = (char *)index + pool_offset;
+
+    /* On duplicate options the first one wins, as with the linear scan */
+    uint32_t used = 0;
+    for (size_t i = 0; i < parser->num_opts; ++i) {
+        const ArgparseOpt *opt = parser->opts + i;
+        const unsigned char short_opt = (unsigned char)opt->short_opt;
+        if (short_opt && !index->short_slots[short_opt])
+            index->short_slots[short_opt] = (uint32_t)i + 1;
+        if (!opt->long_opt)
+            continue;
+        const size_t len = strlen(opt->long_opt);
+        const uint32_t hash = Argparser_hash(opt->long_opt, len);
+        struct ArgparseLongSlot *slot =
+            index->long_slots + (hash & index->long_mask);
+        while (slot->opt &&
+               !(slot->hash == hash && slot->len == len &&
+                 memcmp(index->pool + slot->offset, opt->long_opt, len) == 0))
+            slot = index->long_slots +
+                   ((size_t)(slot - index->long_slots + 1) & index->long_mask);
+        if (slot->opt)
+            continue;
+
+        *slot = (struct ArgparseLongSlot){hash, (uint32_t)len, used,
+                                          (uint32_t)i + 1};
+        memcpy(index->pool + used, opt->long_opt, len + 1);
+        index->names[index->num_names].name = index->pool + used;
+        index->names[index->num_names++].opt = (uint32_t)i;
+        used += (uint32_t)len + 1;
+    }
+
+    qsort(index->names, index->num_names, sizeof *index->names,
+          Argparser_name_cmp);
+    parser->index = index;
+    return 0;
+}
+
+int Argparser_freeze(Argparser *const parser) {
+    return Argparser_alloc_states(parser) || Argparser_build_index(parser, 1);
+}
+
+/* Get a pointer to the ArgparseOpt with the given short option, otherwise
+ * NULL. The lookup is counted in stats unless it is NULL. */
+static ArgparseOpt *Argparser_get_short_opt_ptr(const Argparser *const parser,
+                                                const char short_opt,
+                                                ArgparseStats *const stats) {
+    ARGPARSER_COUNT(stats, lookups, 1);
+    if (parser->lookup)
+        return parser->lookup(parser, short_opt, NULL, 0);
+    if (parser->index) {
+        const uint32_t slot =
+            parser->index->short_slots[(unsigned char)short_opt];
+        ARGPARSER_COUNT(stats, lookup_compares, 1);
+        return slot ? parser->opts + slot - 1 : NULL;
+    }
+    for (size_t i = 0; i < parser->num_opts; ++i)
+        if (short_opt == parser->opts[i].short_opt) {
+            ARGPARSER_COUNT(stats, lookup_compares, i + 1);
+            return parser->opts + i;
+        }
+    ARGPARSER_COUNT(stats, lookup_compares, parser->num_opts);
+    return NULL;
+}
+
+/* Get a pointer to the ArgparseOpt whose long option equals the first len
+ * chars of name, otherwise NULL. name need not be NULL-terminated. The lookup
+ * is counted in stats unless it is NULL. */
+static ArgparseOpt *Argparser_get_long_opt_ptr(const Argparser *const parser,
+                                               const char *const name,
+                                               const size_t len,
+                                               ArgparseStats *const stats) {
+    ARGPARSER_COUNT(stats, lookups, 1);
+    if (parser->lookup)
+        return parser->lookup(parser, '\0', name, len);
+    if (parser->index) {
+        const struct ArgparseIndex *index = parser->index;
+        const uint32_t hash = Argparser_hash(name, len);
+        for (size_t i = hash & index->long_mask; index->long_slots[i].opt;
+             i = (i + 1) & index->long_mask) {
+            const struct ArgparseLongSlot *const slot = index->long_slots + i;
+            ARGPARSER_COUNT(stats, lookup_compares, 1);
+            if (slot->hash == hash && slot->len == len &&
+                memcmp(index->pool + slot->offset, name, len) == 0)
+                return parser->opts + slot->opt - 1;
+        }
+        return NULL;
+    }
+    for (size_t i = 0; i < parser->num_opts; ++i)
+        if (Argparser_long_opt_eq(parser->opts[i].long_opt, name, len)) {
+            ARGPARSER_COUNT(stats, lookup_compares, i + 1);
+            return parser->opts + i;
+        }
+    ARGPARSER_COUNT(stats, lookup_compares, parser->num_opts);
+    return NULL;
+}
+
+/* Find the long options starting with the first len chars of prefix, storing
+ * up to max_matches of them. Returns the number of matches. */
+static size_t Argparser_prefix_matches(const Argparser *const parser,
+                                       const char *const prefix,
+                                       const size_t len,
+                                       const ArgparseOpt **const matches,
+                                       const size_t max_matches) {
+    const struct ArgparseIndex *const index = parser->index;
+    if (index) {
+        /* Names with the prefix are a contiguous run of the sorted names,
+         * found with two binary searches */
+        size_t lo = 0, hi = index->num_names;
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (strncmp(index->names[mid].name, prefix, len) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        const size_t first = lo;
+        hi = index->num_names;
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (strncmp(index->names[mid].name, prefix, len) == 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (size_t i = first; i < lo && i - first < max_matches; ++i)
+            matches[i - first] = parser->opts + index->names[i].opt;
+        return lo - first;
+    }
+
+    /* One pass over the options. A name equal to a stored match belongs to
+     * a later option sharing it, which does not count. */
+    size_t num_matches = 0;
+    for (size_t i = 0; i < parser->num_opts; ++i) {
+        const ArgparseOpt *const opt = parser->opts + i;
+        if (!opt->long_opt || strncmp(opt->long_opt, prefix, len) != 0)
+            continue;
+        const size_t num_stored =
+            num_matches < max_matches ? num_matches : max_matches;
+        size_t j = 0;
+        while (j < num_stored && strcmp(matches[j]->long_opt, opt->long_opt))
+            ++j;
+        if (j < num_stored)
+            continue;
+        if (num_matches < max_matches)
+            matches[num_matches] = opt;
+        ++num_matches;
+    }
+    return num_matches;
+}
+
+size_t Argparser_complete(const Argparser *const parser,
+                          const char *const prefix,
+                          const ArgparseOpt **const matches,
+                          const size_t max_matches) {
+    return Argparser_prefix_matches(parser, prefix, strlen(prefix), matches,
+                                    max_matches);
+}
+
+/* Get a pointer to the ArgparseOpt with matching option, otherwise NULL */
+static ArgparseOpt *Argparser_get_opt_ptr(const Argparser *const parser,
+                                          const char short_opt,
+                                          const char *const long_opt) {
+    if (short_opt)
+        return Argparser_get_short_opt_ptr(parser, short_opt, NULL);
+    if (long_opt)
+        return Argparser_get_long_opt_ptr(parser, long_opt, strlen(long_opt),
+                                          NULL);
+    return NULL;
+}
+
+/* Results of an option before an Argparser_struct parser allocated its
+ * states. Never written: it is not pending conversion. */
+static const ArgparseOptState Argparser_no_state;
+
+/* Get the results for opt, otherwise NULL */
+static ArgparseOptState *Argparser_opt_state(const Argparser *const parser,
+                                             const ArgparseOpt *const opt) {
+    if (!opt)
+        return NULL;
+    if (!parser->results.states)
+        return (ArgparseOptState *)&Argparser_no_state;
+    return parser->results.states + (opt - parser->opts);
+}
+
+/* Token at argv_index, including response file and fed tokens, or NULL */
+static const char *Argparser_results_arg(const ArgparseResults *const results,
+                                         const int argv_index) {
+    if (argv_index < 0)
+        return NULL;
+    if (argv_index < results->argc)
+        return results->argv[argv_index];
+    if ((size_t)(argv_index - results->argc) < results->num_tokens)
+        return results->tokens[argv_index - results->argc];
+    return NULL;
+}
+
+/* A message being formatted into a caller's buffer */
+typedef struct ArgparseMessage {
+    char *buf;
+    size_t size, len;
+} ArgparseMessage;
+
+/* Append to msg like snprintf(3), counting what does not fit */
+static void Argparser_append(ArgparseMessage *const msg,
+                             const char *const format, ...) {
+    va_list args;
+    va_start(args, format);
+    const size_t avail = msg->len < msg->size ? msg->size - msg->len : 0;
+    const int len =
+        vsnprintf(avail ? msg->buf + msg->len : NULL, avail, format, args);
+    va_end(args);
+    if (len > 0)
+        msg->len += (size_t)len;
+}
+
+size_t Argparser_format_error(const Argparser *const parser,
+                              const ArgparseError *const error, char *const buf,
+                              const size_t size) {
+    ArgparseMessage msg = {buf, size, 0};
+    const ArgparseOpt *const opt = error->opt;
+    const int span_len = (int)error->len;
+    const char *const dashes = error->is_long ? "--" : "-";
+    if (size)
+        buf[0] = '\0';
+    Argparser_append(&msg, "%s: ", parser->prog_name);
+
+    switch (error->code) {
+    case ARG_ERROR_NONE:
+        Argparser_append(&msg, "no error");
+        break;
+    case ARG_ERROR_UNKNOWN_OPTION:
+        Argparser_append(&msg, "unknown option '%s%.*s'", dashes, span_len,
+                         error->begin);
+        break;
+    case ARG_ERROR_AMBIGUOUS_OPTION: {
+        /* List the candidates again, as the parse only counted them */
+        const ArgparseOpt *matches[8];
+        const size_t max_matches = sizeof matches / sizeof matches[0];
+        const size_t num_matches = Argparser_prefix_matches(
+            parser, error->begin, error->len, matches, max_matches);
+        Argparser_append(&msg, "option '--%.*s' is ambiguous; possibilities:",
+                         span_len, error->begin);
+        for (size_t i = 0; i < num_matches && i < max_matches; ++i)
+            Argparser_append(&msg, " '--%s'", matches[i]->long_opt);
+        if (num_matches > max_matches)
+            Argparser_append(&msg, " ...");
+        break;
+    }
+    case ARG_ERROR_UNEXPECTED_VALUE:
+        Argparser_append(&msg, "option '--%s' does not take an argument",
+                         opt->long_opt);
+        break;
+    case ARG_ERROR_MISSING_VALUE:
+        if (error->is_long)
+            Argparser_append(&msg, "missing argument for option '--%s'",
+                             opt->long_opt);
+        else
+            Argparser_append(&msg, "missing argument for option '-%c'",
+                             opt->short_opt);
+        break;
+    case ARG_ERROR_INVALID_VALUE:
+    case ARG_ERROR_OUT_OF_RANGE: {
+        const char short_opt_str[2] = {opt->short_opt, '\0'};
+        Argparser_append(
+            &msg, "argument '%.*s' for option '%s%s' is %s", span_len,
+            error->begin, dashes,
+            error->is_long ? opt->long_opt : short_opt_str,
+            error->code == ARG_ERROR_OUT_OF_RANGE ? "out of range"
+            : opt->type == ARG_FLOAT || opt->type == ARG_FLOAT_LIST
+                ? "not a valid floating point number"
+                : "not a valid integer");
+        break;
+    }
+    case ARG_ERROR_TOO_MANY_POS_ARGS:
+        Argparser_append(&msg,
+                         "too many positional arguments (at most %" PRIiMAX
+                         ")",
+                         parser->max_pos_args);
+        break;
+    case ARG_ERROR_TOO_MANY_ARGS:
+        Argparser_append(&msg, "too many arguments");
+        break;
+    case ARG_ERROR_UNKNOWN_COMMAND:
+        Argparser_append(&msg, "unknown command '%.*s'", span_len,
+                         error->begin);
+        break;
+    case ARG_ERROR_COMMAND_SETUP:
+        Argparser_append(&msg, "cannot set up command '%.*s'", span_len,
+                         error->begin);
+        break;
+    case ARG_ERROR_NOT_OWN_RESULTS:
+        Argparser_append(&msg, "subcommands need the parser's own results");
+        break;
+    case ARG_ERROR_RESPONSE_FILE:
+        Argparser_append(&msg, "cannot read response file '%.*s': %s",
+                         span_len, error->begin, strerror(error->sys_errno));
+        break;
+    case ARG_ERROR_NOT_REGULAR_FILE:
+        Argparser_append(&msg, "response file '%.*s' is not a regular file",
+                         span_len, error->begin);
+        break;
+    case ARG_ERROR_NESTED_TOO_DEEPLY:
+        Argparser_append(&msg, "response file '%.*s' is nested too deeply",
+                         span_len, error->begin);
+        break;
+    case ARG_ERROR_UNTERMINATED_QUOTE:
+        Argparser_append(&msg, "unterminated quote in response file '%.*s'",
+                         span_len, error->begin);
+        break;
+    case ARG_ERROR_ALLOCATION:
+        Argparser_append(&msg, "allocation failed");
+        break;
+    default:
+        Argparser_append(&msg, "internal error");
+        break;
+    }
+    return msg.len;
+}
+
+const ArgparseError *Argparser_error(const Argparser *const parser) {
+    return &parser->results.error;
+}
+
+const ArgparseStats *Argparser_stats(const Argparser *const parser) {
+    return &parser->results.stats;
+}
+
+void Argparser_reset_stats(Argparser *const parser) {
+    memset(&parser->results.stats, 0, sizeof parser->results.stats);
+}
+
+size_t Argparser_dump_stats(const ArgparseStats *const stats, char *const buf,
+                            const size_t size) {
+#define ARGPARSER_STAT(name) {#name, offsetof(ArgparseStats, name)}
+    static const struct {
+        const char *name;
+        size_t offset;
+    } counters[] = {
+        ARGPARSER_STAT(parses),
+        ARGPARSER_STAT(tokens),
+        ARGPARSER_STAT(bytes_scanned),
+        ARGPARSER_STAT(lookups),
+        ARGPARSER_STAT(lookup_compares),
+        ARGPARSER_STAT(conversions),
+        ARGPARSER_STAT(response_files),
+        ARGPARSER_STAT(errors),
+        ARGPARSER_STAT(cache_hits),
+        ARGPARSER_STAT(cache_misses),
+        ARGPARSER_STAT(pos_args_reallocs),
+        ARGPARSER_STAT(opts_reallocs),
+        ARGPARSER_STAT(parse_ticks),
+        ARGPARSER_STAT(scan_ticks),
+        ARGPARSER_STAT(lookup_ticks),
+        ARGPARSER_STAT(convert_ticks),
+        ARGPARSER_STAT(file_ticks),
+    };
+#undef ARGPARSER_STAT
+    ArgparseMessage msg = {buf, size, 0};
+    if (size)
+        buf[0] = '\0';
+    for (size_t i = 0; i < sizeof counters / sizeof *counters; ++i) {
+        uint64_t value;
+        memcpy(&value, (const char *)stats + counters[i].offset, sizeof value);
+        Argparser_append(&msg, "%s %" PRIu64 "\n", counters[i].name, value);
+    }
+    return msg.len;
+}
+
+/* Record why parsing failed, printing it only if the parser asks for that.
+ * Returns 1 for the caller to pass on. */
+static int Argparser_fail(const Argparser *const parser,
+                          ArgparseResults *const results,
+                          const ArgparseError error) {
+    results->error = error;
+    ARGPARSER_COUNT(&results->stats, errors, 1);
+    if (!(parser->flags & ARGPARSER_PRINT_ERRORS))
+        return 1;
+
+    char buf[256], *msg = buf;
+    const size_t len =
+        Argparser_format_error(parser, &results->error, buf, sizeof buf);
+    if (len >= sizeof buf &&
+        (msg = Argparser_alloc(results->allocator, len + 1)))
+        Argparser_format_error(parser, &results->error, msg, len + 1);
+    fprintf(stderr, "%s\n", msg ? msg : buf);
+    if (msg != buf)
+        Argparser_free(results->allocator, msg);
+    return 1;
+}
+
+/* Record a failed allocation */
+static int Argparser_fail_alloc(const Argparser *const parser,
+                                ArgparseResults *const results,
+                                const int argv_index) {
+    return Argparser_fail(parser, results,
+                          (ArgparseError){ARG_ERROR_ALLOCATION, argv_index,
+                                          NULL, 0, NULL, 0, 0});
+}
+
+/* Record an error about the whole token at argv_index */
+static int Argparser_fail_token(const Argparser *const parser,
+                                ArgparseResults *const results,
+                                const ArgparseErrorCode code,
+                                const char *const token, const int argv_index) {
+    return Argparser_fail(parser, results,
+                          (ArgparseError){code, argv_index, token,
+                                          strlen(token), NULL, 0, 0});
+}
+
+/* Process a positional argument */
+static int Argparser_recv_pos_arg(const Argparser *const parser,
+                                  ArgparseResults *const results,
+                                  const char *const token,
+                                  const int argv_index) {
+    /* Too many positional arguments */
+    if (0 <= parser->max_pos_args &&
+        parser->max_pos_args <= (intmax_t)results->num_pos_args)
+        return Argparser_fail_token(parser, results,
+                                    ARG_ERROR_TOO_MANY_POS_ARGS, token,
+                                    argv_index);
+
+    /* Grow the pos_args array if needed */
+    if (results->num_pos_args >= results->pos_args_capacity) {
+        int *new_pos_args;
+        ARGPARSER_COUNT(&results->stats, pos_args_reallocs, 1);
+        const size_t old_size =
+            results->pos_args_capacity * sizeof *results->pos_args;
+        results->pos_args_capacity *= 2;
+        if (0 <= parser->max_pos_args &&
+            parser->max_pos_args < (intmax_t)results->pos_args_capacity)
+            results->pos_args_capacity = parser->max_pos_args;
+        if (!(new_pos_args = Argparser_realloc(
+                  results->allocator, results->pos_args, old_size,
+                  results->pos_args_capacity * sizeof *results->pos_args)))
+            return Argparser_fail_alloc(parser, results, argv_index);
+        results->pos_args = new_pos_args;
+    }
+
+    results->pos_args[results->num_pos_args++] = argv_index;
+    return 0;
+}
+
+/* Value of a digit in base 10 or 16, or a value >= 16 for other chars */
+static unsigned Argparser_digit(const char c) {
+    const unsigned d = (unsigned)(unsigned char)c - '0';
+    if (d <= 9)
+        return d;
+    const unsigned x = ((unsigned)(unsigned char)c | 0x20) - 'a';
+    return x < 6 ? x + 10 : 16;
+}
+
+/*
+ * Convert an unsigned number, without a sign, from the first len chars of s.
+ * With ARG_FLAG_HEX, a "0x" prefix selects base 16, and with
+ * ARG_FLAG_SIZE_SUFFIX, a trailing k, m, g, t or p (any case) multiplies by
+ * 2^10, 2^20 etc. Returns 0 on success, 1 if the syntax is invalid and 2 if
+ * the value does not fit. The float conversions also return 3 if they ran
+ * out of memory.
+ */
+static int Argparser_convert_uint(const char *s, size_t len,
+                                  const unsigned flags, uintmax_t *const val) {
+    unsigned base = 10, shift = 0;
+    if ((flags & ARG_FLAG_SIZE_SUFFIX) && len > 1) {
+        static const char suffixes[] = "kmgtp";
+        const char *suffix = memchr(suffixes, s[len - 1] | 0x20, 5);
+        if (suffix) {
+            shift = 10 * (unsigned)(suffix - suffixes + 1);
+            --len;
+        }
+    }
+    if ((flags & ARG_FLAG_HEX) && len > 2 && s[0] == '0' &&
+        (s[1] | 0x20) == 'x') {
+        base = 16;
+        s += 2;
+        len -= 2;
+    }
+    if (!len)
+        return 1;
+
+    uintmax_t v = 0;
+    for (size_t i = 0; i < len; ++i) {
+        const unsigned d = Argparser_digit(s[i]);
+        if (d >= base)
+            return 1;
+        if (__builtin_mul_overflow(v, base, &v) ||
+            __builtin_add_overflow(v, d, &v))
+            return 2;
+    }
+    if (v > UINTMAX_MAX >> shift)
+        return 2;
+    *val = v << shift;
+    return 0;
+}
+
+/* Like Argparser_convert_uint, with an optional sign and a value in
+ * [min, max] */
+static int Argparser_convert_int(const char *s, size_t len,
+                                 const unsigned flags, const intmax_t min,
+                                 const intmax_t max, intmax_t *const val) {
+    const int neg = len && s[0] == '-';
+    if (len && (s[0] == '-' || s[0] == '+')) {
+        ++s;
+        --len;
+    }
+    uintmax_t mag;
+    const int ret = Argparser_convert_uint(s, len, flags, &mag);
+    if (ret)
+        return ret;
+    if (neg ? mag > (uintmax_t)-(min + 1) + 1 : mag > (uintmax_t)max)
+        return 2;
+    /* Avoid overflow when negating the magnitude of min */
+    *val = neg ? -(intmax_t)(mag - 1) - 1 : (intmax_t)mag;
+    if (neg && !mag)
+        *val = 0;
+    return 0;
+}
+
+/* Locale for the strtod fallback, so that the decimal point is always '.' */
+static locale_t Argparser_c_locale;
+static pthread_once_t Argparser_c_locale_once = PTHREAD_ONCE_INIT;
+
+static void Argparser_init_c_locale(void) {
+    Argparser_c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+}
+
+/* Convert with strtod in the C locale, requiring all of the first len chars
+ * of s to be consumed. Values too large for a double are out of range, while
+ * those too small for one are rounded to a subnormal number or zero, as for
+ * the decimal digits a double cannot hold. */
+static int Argparser_strtod(const ArgparseAllocator *const allocator,
+                            const char *const s, const size_t len,
+                            double *const val) {
+    char buf[128], *copy = buf;
+    const char *str = s;
+    /* strtod needs a terminated string */
+    if (s[len] != '\0') {
+        if (len >= sizeof buf && !(copy = Argparser_alloc(allocator, len + 1)))
+            return 3;
+        memcpy(copy, s, len);
+        copy[len] = '\0';
+        str = copy;
+    }
+
+    pthread_once(&Argparser_c_locale_once, Argparser_init_c_locale);
+    char *endptr;
+    const int saved_errno = errno;
+    errno = 0;
+    *val = Argparser_c_locale ? strtod_l(str, &endptr, Argparser_c_locale)
+                              : strtod(str, &endptr);
+    int ret = endptr == str || (size_t)(endptr - str) != len;
+    if (!ret && errno == ERANGE && isinf(*val))
+        ret = 2;
+    errno = saved_errno;
+    if (copy != buf)
+        Argparser_free(allocator, copy);
+    return ret;
+}
+
+/*
+ * Convert a floating point number from the first len chars of s. Decimal
+ * numbers with at most 19 significant digits, a mantissa below 2^53 and a
+ * decimal exponent within [-22, 22] are converted exactly with one
+ * multiplication or division (Clinger's fast path). Everything else, such as
+ * hexadecimal floats, infinities, NaNs and malformed values, goes to strtod,
+ * which decides whether it is valid.
+ */
+static int Argparser_convert_float(const ArgparseAllocator *const allocator,
+                                   const char *const s, const size_t len,
+                                   double *const val) {
+    static const double powers_of_ten[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    /* strtod would skip leading whitespaces */
+    if (!len || isspace((unsigned char)s[0]))
+        return 1;
+
+    size_t i = 0;
+    const int neg = s[0] == '-';
+    if (s[0] == '-' || s[0] == '+')
+        ++i;
+
+    uint64_t mantissa = 0;
+    int num_digits = 0, num_sig_digits = 0, exponent = 0;
+    for (int seen_point = 0; i < len; ++i) {
+        const unsigned d = (unsigned)(unsigned char)s[i] - '0';
+        if (d <= 9) {
+            ++num_digits;
+            if (mantissa || d)
+                ++num_sig_digits;
+            if (num_sig_digits > 19)
+                return Argparser_strtod(allocator, s, len, val);
+            mantissa = 10 * mantissa + d;
+            exponent -= seen_point;
+        } else if (s[i] == '.' && !seen_point) {
+            seen_point = 1;
+        } else {
+            break;
+        }
+    }
+    if (!num_digits)
+        return Argparser_strtod(allocator, s, len, val);
+
+    if (i < len && (s[i] | 0x20) == 'e') {
+        size_t j = i + 1;
+        const int exp_neg = j < len && s[j] == '-';
+        if (j < len && (s[j] == '-' || s[j] == '+'))
+            ++j;
+        if (j == len)
+            return Argparser_strtod(allocator, s, len, val);
+        int exp = 0;
+        for (; j < len; ++j) {
+            const unsigned d = (unsigned)(unsigned char)s[j] - '0';
+            if (d > 9)
+                return Argparser_strtod(allocator, s, len, val);
+            if (exp < 10000)
+                exp = 10 * exp + (int)d;
+        }
+        exponent += exp_neg ? -exp : exp;
+        i = j;
+    }
+    if (i != len)
+        return Argparser_strtod(allocator, s, len, val);
+
+    if (mantissa > (UINT64_C(1) << 53) || exponent < -22 || exponent > 22)
+        return Argparser_strtod(allocator, s, len, val);
+    double v = (double)mantissa;
+    v = exponent < 0 ? v / powers_of_ten[-exponent]
+                     : v * powers_of_ten[exponent];
+    *val = neg ? -v : v;
+    return 0;
+}
+
+static int Argparser_is_unsigned(const ArgparseType type) {
+    return ARG_UINT <= type && type <= ARG_UINT64;
+}
+
+static int Argparser_is_list(const ArgparseType type) {
+    return ARG_INT_LIST <= type && type <= ARG_STR_LIST;
+}
+
+/* Range of an integer type, returns whether it is signed */
+static int Argparser_int_range(const ArgparseType type, intmax_t *const min,
+                               uintmax_t *const max) {
+    switch (type) {
+    case ARG_INT8:
+        *min = INT8_MIN, *max = INT8_MAX;
+        return 1;
+    case ARG_INT16:
+        *min = INT16_MIN, *max = INT16_MAX;
+        return 1;
+    case ARG_INT32:
+        *min = INT32_MIN, *max = INT32_MAX;
+        return 1;
+    case ARG_INT64:
+        *min = INT64_MIN, *max = INT64_MAX;
+        return 1;
+    case ARG_UINT8:
+        *min = 0, *max = UINT8_MAX;
+        return 0;
+    case ARG_UINT16:
+        *min = 0, *max = UINT16_MAX;
+        return 0;
+    case ARG_UINT32:
+        *min = 0, *max = UINT32_MAX;
+        return 0;
+    case ARG_UINT64:
+        *min = 0, *max = UINT64_MAX;
+        return 0;
+    case ARG_UINT:
+        *min = 0, *max = UINTMAX_MAX;
+        return 0;
+    default:
+        *min = INTMAX_MIN, *max = INTMAX_MAX;
+        return 1;
+    }
+}
+
+/* Convert the value of a numeric option into state. Only store converted
+ * values on success, so that Argparser_reset need not visit options without
+ * occurrences. */
+static ArgparseConversion Argparser_convert_value(
+    const Argparser *const parser, const ArgparseOpt *const opt,
+    ArgparseOptState *const state, const char *const val,
+    const size_t val_strlen) {
+    intmax_t min, int_val;
+    uintmax_t max, uint_val;
+    double float_val;
+    int ret;
+    if (opt->type == ARG_FLOAT) {
+        if (!(ret = Argparser_convert_float(parser->allocator, val, val_strlen,
+                                            &float_val)))
+            state->float_val = float_val;
+    } else if (Argparser_int_range(opt->type, &min, &max)) {
+        if (!(ret = Argparser_convert_int(val, val_strlen, opt->flags, min,
+                                          (intmax_t)max, &int_val)))
+            state->int_val = int_val;
+    } else {
+        /* Unsigned values may have a plus sign, but not a minus sign */
+        const size_t sign = val_strlen && val[0] == '+';
+        if (!(ret = Argparser_convert_uint(val + sign, val_strlen - sign,
+                                           opt->flags, &uint_val)) &&
+            uint_val > max)
+            ret = 2;
+        if (!ret)
+            state->uint_val = uint_val;
+    }
+    return ret == 0   ? ARG_CONVERSION_OK
+           : ret == 1 ? ARG_CONVERSION_INVALID
+           : ret == 2 ? ARG_CONVERSION_OUT_OF_RANGE
+                      : ARG_CONVERSION_NO_MEMORY;
+}
+
+/* Number of times c occurs in the len chars at s, 16 at a time with SSE2 */
+static size_t Argparser_count_char(const char *const s, const size_t len,
+                                   const char c) {
+    size_t count = 0, i = 0;
+#if defined(ARGPARSER_X86_SIMD) && defined(__SSE2__)
+    /* SSE2 is part of x86-64, so this needs no dispatch */
+    const __m128i v = _mm_set1_epi8(c);
+    for (; i + 16 <= len; i += 16) {
+        const __m128i block = _mm_loadu_si128((const __m128i *)(s + i));
+        count += (size_t)__builtin_popcount(
+            (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, v)));
+    }
+#endif
+    for (; i < len; ++i)
+        count += s[i] == c;
+    return count;
+}
+
+/* Carve size bytes for list items out of the list blocks, aligned for any
+ * item type. Items never move until the blocks are freed or reused. */
+static void *Argparser_alloc_items(ArgparseResults *const results,
+                                   const size_t size) {
+    struct ArgparseBlock *block = results->list_blocks;
+    size_t pad = 0;
+    if (block)
+        pad = (size_t)(-(uintptr_t)(block->data + block->used) &
+                       (ARGPARSER_ALIGN - 1));
+    if (!block || block->size - block->used < pad + size) {
+        size_t block_size = ARGPARSER_BLOCK_SIZE;
+        while (block_size < size + ARGPARSER_ALIGN)
+            block_size *= 2;
+        if (!(block = Argparser_alloc(results->allocator,
+                                      sizeof *block + block_size)))
+            return NULL;
+        block->next = results->list_blocks;
+        block->size = block_size;
+        block->used = 0;
+        results->list_blocks = block;
+        pad = (size_t)(-(uintptr_t)block->data & (ARGPARSER_ALIGN - 1));
+    }
+    void *const items = block->data + block->used + pad;
+    block->used += pad + size;
+    return items;
+}
+
+/* Size of one item of a list option */
+static size_t Argparser_item_size(const ArgparseType type) {
+    return type == ARG_INT_LIST     ? sizeof(intmax_t)
+           : type == ARG_FLOAT_LIST ? sizeof(double)
+                                    : sizeof(ArgparseSpan);
+}
+
+/* Items of every empty list, so that queries tell an empty list from an
+ * option that did not occur */
+static const union {
+    intmax_t int_val;
+    double float_val;
+    ArgparseSpan span;
+} Argparser_empty_list;
+
+/* Items of a list option as queries see them, never NULL */
+static const void *Argparser_list_items(const ArgparseOptState *const state) {
+    return state->num_items ? state->items : &Argparser_empty_list;
+}
+
+/* Split the value of a list option at its delimiter and convert the items
+ * into one contiguous array. Counting the delimiters to size the array is
+ * vectorized, see Argparser_count_char; finding and converting the items is
+ * not. */
+static int Argparser_split_list(const Argparser *const parser,
+                                ArgparseResults *const results,
+                                const ArgparseOpt *const opt,
+                                ArgparseOptState *const state,
+                                const char *const val, const size_t val_strlen,
+                                const int argv_index, const int is_long_opt) {
+    const char delimiter = opt->flags >> 24 ? (char)(opt->flags >> 24) : ',';
+    const size_t item_size = Argparser_item_size(opt->type);
+    const size_t num_items =
+        val_strlen ? Argparser_count_char(val, val_strlen, delimiter) + 1 : 0;
+    char *items = NULL;
+    if (num_items &&
+        !(items = Argparser_alloc_items(results, num_items * item_size)))
+        return Argparser_fail_alloc(parser, results, argv_index);
+    if (opt->type != ARG_STR_LIST)
+        ARGPARSER_COUNT(&results->stats, conversions, num_items);
+
+    const char *item = val, *const end = val + val_strlen;
+    for (size_t i = 0; i < num_items; ++i) {
+        const char *next = memchr(item, delimiter, (size_t)(end - item));
+        if (!next)
+            next = end;
+        const size_t len = (size_t)(next - item);
+        int ret = 0;
+        if (opt->type == ARG_INT_LIST) {
+            ret = Argparser_convert_int(item, len, opt->flags, INTMAX_MIN,
+                                        INTMAX_MAX, (intmax_t *)items + i);
+        } else if (opt->type == ARG_FLOAT_LIST) {
+            ret = Argparser_convert_float(parser->allocator, item, len,
+                                          (double *)items + i);
+        } else {
+            ((ArgparseSpan *)items)[i].begin = item;
+            ((ArgparseSpan *)items)[i].len = len;
+        }
+        if (ret == 3)
+            return Argparser_fail_alloc(parser, results, argv_index);
+        if (ret)
+            return Argparser_fail(
+                parser, results,
+                (ArgparseError){ret == 1 ? ARG_ERROR_INVALID_VALUE
+                                         : ARG_ERROR_OUT_OF_RANGE,
+                                argv_index, item, len, opt, is_long_opt, 0});
+        item = next + 1;
+    }
+    state->items = items;
+    state->num_items = num_items;
+    state->conversion = ARG_CONVERSION_OK;
+    return 0;
+}
+
+static int Argparser_handle_opt(const Argparser *const parser,
+                                ArgparseResults *const results,
+                                const ArgparseOpt *const opt,
+                                ArgparseOptState *const state,
+                                const char *const val, const size_t val_strlen,
+                                const int argv_index, const int is_long_opt) {
+    ArgparseError error = {ARG_ERROR_INTERNAL, argv_index, val,
+                           val_strlen, opt, is_long_opt, 0};
+    if (opt->type == ARG_STR)
+        return 0;
+    if (opt->type == ARG_BOOL)
+        return Argparser_fail(parser, results, error);
+    if (Argparser_is_list(opt->type))
+        return Argparser_split_list(parser, results, opt, state, val,
+                                    val_strlen, argv_index, is_long_opt);
+
+    /* Leave the value for the first query. Every occurrence of accumulated
+     * options is converted, as occurrences are read directly, and so are
+     * values written to a destination. */
+    if ((parser->flags & ARGPARSER_LAZY_CONVERSION) &&
+        !(opt->flags & ARG_FLAG_ACCUMULATE) && !opt->dest) {
+        state->conversion = ARG_CONVERSION_PENDING;
+        return 0;
+    }
+
+    ARGPARSER_COUNT(&results->stats, conversions, 1);
+    switch (Argparser_convert_value(parser, opt, state, val, val_strlen)) {
+    case ARG_CONVERSION_OK:
+        state->conversion = ARG_CONVERSION_OK;
+        return 0;
+    case ARG_CONVERSION_INVALID:
+        error.code = ARG_ERROR_INVALID_VALUE;
+        return Argparser_fail(parser, results, error);
+    case ARG_CONVERSION_NO_MEMORY:
+        return Argparser_fail_alloc(parser, results, argv_index);
+    default:
+        error.code = ARG_ERROR_OUT_OF_RANGE;
+        return Argparser_fail(parser, results, error);
+    }
+}
+
+/* Write the results of opt to its destination */
+static void Argparser_store(const ArgparseOpt *const opt,
+                            const ArgparseOptState *const state) {
+    void *const dest = opt->dest;
+    if (state->conversion != ARG_CONVERSION_OK)
+        return;
+    switch (opt->type) {
+    case ARG_BOOL:
+        *(int *)dest = state->count;
+        break;
+    case ARG_STR:
+        ((ArgparseSpan *)dest)->begin = state->begin;
+        ((ArgparseSpan *)dest)->len = state->val_strlen;
+        break;
+    case ARG_FLOAT:
+        *(double *)dest = state->float_val;
+        break;
+    case ARG_INT:
+        *(intmax_t *)dest = state->int_val;
+        break;
+    case ARG_INT8:
+        *(int8_t *)dest = (int8_t)state->int_val;
+        break;
+    case ARG_INT16:
+        *(int16_t *)dest = (int16_t)state->int_val;
+        break;
+    case ARG_INT32:
+        *(int32_t *)dest = (int32_t)state->int_val;
+        break;
+    case ARG_INT64:
+        *(int64_t *)dest = (int64_t)state->int_val;
+        break;
+    case ARG_UINT:
+        *(uintmax_t *)dest = state->uint_val;
+        break;
+    case ARG_UINT8:
+        *(uint8_t *)dest = (uint8_t)state->uint_val;
+        break;
+    case ARG_UINT16:
+        *(uint16_t *)dest = (uint16_t)state->uint_val;
+        break;
+    case ARG_UINT32:
+        *(uint32_t *)dest = (uint32_t)state->uint_val;
+        break;
+    case ARG_UINT64:
+        *(uint64_t *)dest = (uint64_t)state->uint_val;
+        break;
+    case ARG_INT_LIST:
+    case ARG_FLOAT_LIST:
+    case ARG_STR_LIST:
+        ((ArgparseList *)dest)->items = Argparser_list_items(state);
+        ((ArgparseList *)dest)->num_items = state->num_items;
+        break;
+    }
+}
+
+/* Record an occurrence of opt, whose value (if any) has been converted */
+static int Argparser_record_opt(const Argparser *const parser,
+                                ArgparseResults *const results,
+                                const ArgparseOpt *const opt,
+                                ArgparseOptState *const state,
+                                const char *const begin,
+                                const size_t val_strlen, const int argv_index) {
+    if (!state->count++) {
+        /* First occurrence since the last reset */
+        state->next_touched = results->touched;
+        results->touched = (size_t)(opt - parser->opts) + 1;
+    }
+    state->argv_index = argv_index;
+    state->begin = begin;
+    state->val_strlen = val_strlen;
+    if (opt->dest && results == &parser->results)
+        Argparser_store(opt, state);
+    if (!(opt->flags & ARG_FLAG_ACCUMULATE))
+        return 0;
+
+    /* Grow the occurrences array if needed */
+    if (results->num_occurrences >= results->occurrences_capacity) {
+        ArgparseOccurrence *new_occurrences;
+        if (!(new_occurrences = Argparser_grow(
+                  results->allocator, results->occurrences,
+                  &results->occurrences_capacity,
+                  sizeof *results->occurrences)))
+            return Argparser_fail_alloc(parser, results, argv_index);
+        results->occurrences = new_occurrences;
+    }
+
+    ArgparseOccurrence *occ = results->occurrences + results->num_occurrences++;
+    occ->begin = begin;
+    occ->val_strlen = val_strlen;
+    occ->argv_index = argv_index;
+    occ->next = 0;
+    /* Occurrences of list options only keep their text */
+    if (Argparser_is_list(opt->type))
+        occ->uint_val = 0;
+    else if (opt->type == ARG_FLOAT)
+        occ->float_val = state->float_val;
+    else if (Argparser_is_unsigned(opt->type))
+        occ->uint_val = state->uint_val;
+    else
+        occ->int_val = state->int_val;
+    /* Link it after the previous occurrence of the same option */
+    if (state->last_occurrence)
+        results->occurrences[state->last_occurrence - 1].next =
+            results->num_occurrences;
+    else
+        state->first_occurrence = results->num_occurrences;
+    state->last_occurrence = results->num_occurrences;
+    return 0;
+}
+
+/*
+ * Token scanning. Each token is scanned once for both its length and its
+ * first '=', which locates the value of "--name=value". The scan stops at a
+ * '\0' or after limit bytes, whichever comes first.
+ */
+typedef size_t (*ArgparseScanner)(const char *s, size_t limit,
+                                  const char **equal_sign);
+
+static size_t Argparser_scan_scalar(const char *const s, const size_t limit,
+                                    const char **const equal_sign) {
+    size_t i = 0;
+    *equal_sign = NULL;
+    for (; i < limit && s[i]; ++i) {
+        if (s[i] == '=') {
+            *equal_sign = s + i++;
+            break;
+        }
+    }
+    while (i < limit && s[i])
+        ++i;
+    return i;
+}
+
+#ifdef ARGPARSER_X86_SIMD
+/* Clamp the result of a vector scan to limit */
+static size_t Argparser_scan_clamp(const char *const s, const size_t limit,
+                                   const size_t len,
+                                   const char **const equal_sign) {
+    const size_t clamped = len < limit ? len : limit;
+    if (*equal_sign && (size_t)(*equal_sign - s) >= clamped)
+        *equal_sign = NULL;
+    return clamped;
+}
+
+/*
+ * The vector scanners only load aligned blocks, which never cross a page
+ * boundary, so reading the bytes around the string is safe even though they
+ * are not part of it. Bits for bytes before s are masked off.
+ */
+__attribute__((target("sse2"), no_sanitize_address)) static size_t
+Argparser_scan_sse2(const char *const s, const size_t limit,
+                    const char **const equal_sign) {
+    const __m128i zero = _mm_setzero_si128(), eq = _mm_set1_epi8('=');
+    const char *block = (const char *)((uintptr_t)s & ~(uintptr_t)15);
+    uint32_t head = ~UINT32_C(0) << (s - block);
+    *equal_sign = NULL;
+    for (;; block += 16, head = ~UINT32_C(0)) {
+        const __m128i v = _mm_load_si128((const __m128i *)block);
+        const uint32_t nul_mask =
+            (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) & head;
+        uint32_t eq_mask =
+            (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, eq)) & head;
+        if (nul_mask)
+            eq_mask &= (nul_mask & -nul_mask) - 1;
+        if (eq_mask && !*equal_sign)
+            *equal_sign = block + __builtin_ctz(eq_mask);
+        if (nul_mask)
+            return Argparser_scan_clamp(
+                s, limit, (size_t)(block - s) + __builtin_ctz(nul_mask),
+                equal_sign);
+        if ((size_t)(block + 16 - s) >= limit)
+            return Argparser_scan_clamp(s, limit, limit, equal_sign);
+    }
+}
+
+__attribute__((target("avx2"), no_sanitize_address)) static size_t
+Argparser_scan_avx2(const char *const s, const size_t limit,
+                    const char **const equal_sign) {
+    const __m256i zero = _mm256_setzero_si256(), eq = _mm256_set1_epi8('=');
+    const char *block = (const char *)((uintptr_t)s & ~(uintptr_t)31);
+    uint32_t head = ~UINT32_C(0) << (s - block);
+    *equal_sign = NULL;
+    for (;; block += 32, head = ~UINT32_C(0)) {
+        const __m256i v = _mm256_load_si256((const __m256i *)block);
+        const uint32_t nul_mask =
+            (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero)) & head;
+        uint32_t eq_mask =
+            (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, eq)) & head;
+        if (nul_mask)
+            eq_mask &= (nul_mask & -nul_mask) - 1;
+        if (eq_mask && !*equal_sign)
+            *equal_sign = block + __builtin_ctz(eq_mask);
+        if (nul_mask)
+            return Argparser_scan_clamp(
+                s, limit, (size_t)(block - s) + __builtin_ctz(nul_mask),
+                equal_sign);
+        if ((size_t)(block + 32 - s) >= limit)
+            return Argparser_scan_clamp(s, limit, limit, equal_sign);
+    }
+}
+#endif
+
+/* Pick the best scanner for this CPU on first use */
+static size_t Argparser_scan_resolve(const char *s, size_t limit,
+                                     const char **equal_sign);
+
+static ArgparseScanner Argparser_scanner = Argparser_scan_resolve;
+
+static size_t Argparser_scan_resolve(const char *const s, const size_t limit,
+                                     const char **const equal_sign) {
+    ArgparseScanner scanner = Argparser_scan_scalar;
+#ifdef ARGPARSER_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        scanner = Argparser_scan_avx2;
+    else if (__builtin_cpu_supports("sse2"))
+        scanner = Argparser_scan_sse2;
+#endif
+    __atomic_store_n(&Argparser_scanner, scanner, __ATOMIC_RELAXED);
+    return scanner(s, limit, equal_sign);
+}
+
+/* Scan a token with the scanner resolved for this CPU, counting it in the
+ * stats of results */
+static size_t Argparser_scan(ArgparseResults *const results,
+                             const char *const s, const size_t limit,
+                             const char **const equal_sign) {
+    ARGPARSER_TIMER(start);
+    const size_t len = __atomic_load_n(&Argparser_scanner, __ATOMIC_RELAXED)(
+        s, limit, equal_sign);
+    ARGPARSER_ELAPSED(&results->stats, scan_ticks, start);
+    ARGPARSER_COUNT(&results->stats, bytes_scanned, len);
+    return len;
+}
+
+/* Process the value of an option that takes one */
+static int Argparser_recv_opt_val(const Argparser *const parser,
+                                  ArgparseResults *const results,
+                                  const ArgparseOpt *const opt,
+                                  const char *const begin,
+                                  const size_t val_strlen, const int argv_index,
+                                  const int is_long_opt) {
+    ArgparseOptState *state = results->states + (size_t)(opt - parser->opts);
+    ARGPARSER_TIMER(start);
+    const int failed = Argparser_handle_opt(parser, results, opt, state, begin,
+                                            val_strlen, argv_index,
+                                            is_long_opt);
+    ARGPARSER_ELAPSED(&results->stats, convert_ticks, start);
+    if (failed)
+        return 1;
+    return Argparser_record_opt(parser, results, opt, state, begin, val_strlen,
+                                argv_index);
+}
+
+/* Process a token of one or more short options, such as "-vvn10" */
+static int Argparser_recv_short_opts(const Argparser *const parser,
+                                     ArgparseResults *const results,
+                                     const char *const token, const size_t len,
+                                     const int argv_index) {
+    for (size_t i = 1; i < len; ++i) {
+        const char short_opt = token[i];
+        ARGPARSER_TIMER(start);
+        const ArgparseOpt *const opt =
+            Argparser_get_short_opt_ptr(parser, short_opt, &results->stats);
+        ARGPARSER_ELAPSED(&results->stats, lookup_ticks, start);
+        if (!opt)
+            return Argparser_fail(parser, results,
+                                  (ArgparseError){ARG_ERROR_UNKNOWN_OPTION,
+                                                  argv_index, token + i, 1,
+                                                  NULL, 0, 0});
+
+        if (opt->type == ARG_BOOL) {
+            /* Option doesn't take an argument, look at the next character */
+            ArgparseOptState *state =
+                results->states + (size_t)(opt - parser->opts);
+            if (Argparser_record_opt(parser, results, opt, state, token + i, 0,
+                                     argv_index))
+                return 1;
+        } else if (i + 1 < len) {
+            /* Value is the rest of the token */
+            return Argparser_recv_opt_val(parser, results, opt, token + i + 1,
+                                          len - i - 1, argv_index, 0);
+        } else {
+            /* Value is the next token */
+            results->pending_opt = opt;
+            results->pending_is_long = 0;
+            results->pending_argv_index = argv_index;
+        }
+    }
+    return 0;
+}
+
+/* Process a long option token, such as "--name" or "--name=value", whose
+ * first equal sign was found by Argparser_scan */
+static int Argparser_recv_long_opt(const Argparser *const parser,
+                                   ArgparseResults *const results,
+                                   const char *const token, const size_t len,
+                                   const char *const equal_sign,
+                                   const int argv_index) {
+    /* opt_name is *not* NULL-terminated if there is an equal sign */
+    const char *const opt_name = token + 2;
+    const size_t name_len =
+        equal_sign ? (size_t)(equal_sign - opt_name) : len - 2;
+    ARGPARSER_TIMER(start);
+    const ArgparseOpt *opt = Argparser_get_long_opt_ptr(
+        parser, opt_name, name_len, &results->stats);
+    size_t num_matches = 0;
+    if (!opt && (parser->flags & ARGPARSER_ABBREVIATIONS) && name_len)
+        /* Only count the candidates, formatting lists them if asked */
+        num_matches =
+            Argparser_prefix_matches(parser, opt_name, name_len, &opt, 1);
+    ARGPARSER_ELAPSED(&results->stats, lookup_ticks, start);
+    if (num_matches > 1)
+        return Argparser_fail(parser, results,
+                              (ArgparseError){ARG_ERROR_AMBIGUOUS_OPTION,
+                                              argv_index, opt_name, name_len,
+                                              NULL, 1, 0});
+    if (!opt)
+        return Argparser_fail(parser, results,
+                              (ArgparseError){ARG_ERROR_UNKNOWN_OPTION,
+                                              argv_index, opt_name, name_len,
+                                              NULL, 1, 0});
+
+    if (opt->type == ARG_BOOL) {
+        if (equal_sign)
+            return Argparser_fail(parser, results,
+                                  (ArgparseError){ARG_ERROR_UNEXPECTED_VALUE,
+                                                  argv_index, equal_sign + 1,
+                                                  len - name_len - 3, opt, 1,
+                                                  0});
+        ArgparseOptState *state =
+            results->states + (size_t)(opt - parser->opts);
+        return Argparser_record_opt(parser, results, opt, state, opt_name, 0,
+                                    argv_index);
+    }
+    if (equal_sign) {
+        /* Value is after the equal sign */
+        return Argparser_recv_opt_val(parser, results, opt, equal_sign + 1,
+                                      len - name_len - 3, argv_index, 1);
+    }
+    /* Value is the next token */
+    results->pending_opt = opt;
+    results->pending_is_long = 1;
+    results->pending_argv_index = argv_index;
+    return 0;
+}
+
+static int Argparser_recv_token(const Argparser *const parser,
+                                ArgparseResults *const results,
+                                const char *const token, const size_t len,
+                                const char *const equal_sign,
+                                const int argv_index, const int depth);
+
+/* Map a response file privately and writably, followed by a '\0' byte */
+static char *Argparser_map_file(const Argparser *const parser,
+                                ArgparseResults *const results,
+                                const char *const path, size_t *const size,
+                                const int argv_index) {
+    struct stat st;
+    char *data = NULL;
+    ArgparseError error = {ARG_ERROR_RESPONSE_FILE, argv_index, path,
+                           strlen(path), NULL, 0, 0};
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st)) {
+        error.sys_errno = errno;
+        Argparser_fail(parser, results, error);
+        goto map_file_exit;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        error.code = ARG_ERROR_NOT_REGULAR_FILE;
+        Argparser_fail(parser, results, error);
+        goto map_file_exit;
+    }
+    *size = (size_t)st.st_size;
+
+    /* Grow the mappings array if needed */
+    if (results->num_mappings >= results->mappings_capacity) {
+        struct ArgparseMapping *new_mappings;
+        if (!(new_mappings = Argparser_grow(
+                  results->allocator, results->mappings,
+                  &results->mappings_capacity, sizeof *results->mappings))) {
+            Argparser_fail_alloc(parser, results, argv_index);
+            goto map_file_exit;
+        }
+        results->mappings = new_mappings;
+    }
+
+    /* Reserve one byte more than the file with an anonymous mapping, and map
+     * the file over it. The byte after the file is then a zero byte within
+     * the mapping, even when the file size is a multiple of the page size. */
+    void *addr = mmap(NULL, *size + 1, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        error.sys_errno = errno;
+        Argparser_fail(parser, results, error);
+        goto map_file_exit;
+    }
+    if (*size && mmap(addr, *size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        error.sys_errno = errno;
+        munmap(addr, *size + 1);
+        Argparser_fail(parser, results, error);
+        goto map_file_exit;
+    }
+    results->mappings[results->num_mappings].addr = addr;
+    results->mappings[results->num_mappings++].len = *size + 1;
+    data = addr;
+
+map_file_exit:
+    if (fd >= 0)
+        close(fd);
+    return data;
+}
+
+/* Give a response file or fed token the next synthetic argv index */
+static int Argparser_add_token(const Argparser *const parser,
+                               ArgparseResults *const results,
+                               const char *const token) {
+    if (results->num_tokens >= (size_t)(INT_MAX - results->argc)) {
+        Argparser_fail_token(parser, results, ARG_ERROR_TOO_MANY_ARGS, token,
+                             -1);
+        return -1;
+    }
+
+    /* Grow the tokens array if needed */
+    if (results->num_tokens >= results->tokens_capacity) {
+        const char **new_tokens;
+        if (!(new_tokens = Argparser_grow(results->allocator, results->tokens,
+                                          &results->tokens_capacity,
+                                          sizeof *results->tokens))) {
+            Argparser_fail_alloc(parser, results, -1);
+            return -1;
+        }
+        results->tokens = new_tokens;
+    }
+
+    results->tokens[results->num_tokens] = token;
+    return results->argc + (int)results->num_tokens++;
+}
+
+/*
+ * Expand "@path". The file is split at unquoted whitespace, where '...'
+ * quotes literally and "..." and a bare backslash escape the next character.
+ * Quotes and escapes are removed in place, so tokens point into the mapping.
+ */
+static int Argparser_recv_response_file(const Argparser *const parser,
+                                        ArgparseResults *const results,
+                                        const char *const path,
+                                        const int argv_index,
+                                        const int depth) {
+    if (depth >= ARGPARSER_MAX_RESPONSE_DEPTH)
+        return Argparser_fail_token(parser, results,
+                                    ARG_ERROR_NESTED_TOO_DEEPLY, path,
+                                    argv_index);
+
+    size_t size;
+    char *src, *end;
+    ARGPARSER_TIMER(start);
+    src = Argparser_map_file(parser, results, path, &size, argv_index);
+    ARGPARSER_ELAPSED(&results->stats, file_ticks, start);
+    if (!src)
+        return 1;
+    ARGPARSER_COUNT(&results->stats, response_files, 1);
+    ARGPARSER_COUNT(&results->stats, bytes_scanned, size);
+    for (end = src + size;;) {
+        while (src < end && isspace((unsigned char)*src))
+            ++src;
+        if (src == end)
+            return 0;
+
+        char *const token = src, *dst = src, quote = '\0';
+        const char *equal_sign = NULL;
+        for (; src < end && (quote || !isspace((unsigned char)*src)); ++src) {
+            if (quote && *src == quote) {
+                quote = '\0';
+                continue;
+            }
+            if (!quote && (*src == '\'' || *src == '"')) {
+                quote = *src;
+                continue;
+            }
+            if (*src == '\\' && quote != '\'' && src + 1 < end)
+                ++src;
+            /* Note the first equal sign while copying */
+            if (*src == '=' && !equal_sign)
+                equal_sign = dst;
+            *dst++ = *src;
+        }
+        if (quote)
+            return Argparser_fail_token(parser, results,
+                                        ARG_ERROR_UNTERMINATED_QUOTE, path,
+                                        argv_index);
+        /* Skip the delimiter before overwriting it. dst never passes src,
+         * and the mapping ends with a spare byte. */
+        if (src < end)
+            ++src;
+        *dst = '\0';
+
+        const int argv_index = Argparser_add_token(parser, results, token);
+        if (argv_index < 0 ||
+            Argparser_recv_token(parser, results, token, (size_t)(dst - token),
+                                 equal_sign, argv_index, depth + 1))
+            return 1;
+    }
+}
+
+/*
+ * Select the subcommand named by the first positional argument and add its
+ * options. That changes the parser, which is allowed for the parser's own
+ * results only, as those are what Argparser_parse and Argparser_feed* use.
+ */
+static int Argparser_select_subcommand(const Argparser *const parser,
+                                       ArgparseResults *const results,
+                                       const char *const token,
+                                       const size_t len, const int argv_index) {
+    Argparser *const own_parser = (Argparser *)parser;
+    ArgparseError error = {ARG_ERROR_NOT_OWN_RESULTS, argv_index, token,
+                           len, NULL, 0, 0};
+    if (results != &parser->results)
+        return Argparser_fail(parser, results, error);
+
+    if (!parser->subcommand_slots)
+        Argparser_build_subcommand_slots(own_parser);
+    const size_t i = Argparser_find_subcommand(parser, token, len);
+    if (i == parser->num_subcommands) {
+        error.code = ARG_ERROR_UNKNOWN_COMMAND;
+        return Argparser_fail(parser, results, error);
+    }
+
+    const ArgparseSubcommand *const subcommand = parser->subcommands + i;
+    results->subcommand = i + 1;
+    if (parser->loaded_subcommand == i + 1) {
+        /* Bring back the options it added last time */
+        own_parser->global_index = parser->index;
+        own_parser->index = parser->loaded_index;
+        own_parser->loaded_index = NULL;
+        own_parser->num_opts = parser->num_loaded_opts;
+        own_parser->num_loaded_opts = 0;
+        Argparser_build_index(own_parser, 0);
+        return 0;
+    }
+
+    Argparser_unload_subcommand(own_parser);
+    own_parser->num_global_opts = parser->num_opts;
+    /* The options the subcommand adds need an index of their own, but the
+     * one over the global options stays valid for after the reset */
+    own_parser->global_index = parser->index;
+    own_parser->index = NULL;
+    if (subcommand->init(own_parser, subcommand->data)) {
+        error.code = ARG_ERROR_COMMAND_SETUP;
+        return Argparser_fail(parser, results, error);
+    }
+    own_parser->loaded_subcommand = i + 1;
+    Argparser_build_index(own_parser, 0);
+    return 0;
+}
+
+/* Process one command line token of length len, with its first equal sign
+ * (or NULL) */
+static int Argparser_recv_token(const Argparser *const parser,
+                                ArgparseResults *const results,
+                                const char *const token, const size_t len,
+                                const char *const equal_sign,
+                                const int argv_index, const int depth) {
+    ARGPARSER_COUNT(&results->stats, tokens, 1);
+    if (!results->pos_args_only && token[0] == '@' &&
+        (parser->flags & ARGPARSER_RESPONSE_FILES))
+        return Argparser_recv_response_file(parser, results, token + 1,
+                                            argv_index, depth);
+
+    if (results->pending_opt) {
+        const ArgparseOpt *opt = results->pending_opt;
+        results->pending_opt = NULL;
+        return Argparser_recv_opt_val(parser, results, opt, token, len,
+                                      argv_index, results->pending_is_long);
+    }
+
+    if (!results->pos_args_only && len >= 3 && token[0] == '-' &&
+        token[1] == '-')
+        return Argparser_recv_long_opt(parser, results, token, len,
+                                       equal_sign, argv_index);
+    if (!results->pos_args_only && len >= 2 && token[0] == '-') {
+        if (token[1] != '-')
+            return Argparser_recv_short_opts(parser, results, token, len,
+                                             argv_index);
+        results->pos_args_only = 1;
+        return 0;
+    }
+    if (parser->num_subcommands && !results->subcommand)
+        return Argparser_select_subcommand(parser, results, token, len,
+                                           argv_index);
+    return Argparser_recv_pos_arg(parser, results, token, argv_index);
+}
+
+/* End a command line */
+static int Argparser_finish_results(const Argparser *const parser,
+                                    ArgparseResults *const results);
 
-    parser->opts_capacity = ARGPARSER_INITIAL_CAPACITY;
-    if (!(parser->opts = malloc(parser->opts_capacity * sizeof *parser->opts)))
-        return 1;
+/* Parse a whole command line, see Argparser_parse_results */
+static int Argparser_parse_argv(const Argparser *const parser,
+                                ArgparseResults *const results, const int argc,
+                                const char *const *const argv) {
+    results->argc = argc;
+    results->argv = argv;
+    results->num_tokens = 0;
+    results->pending_opt = NULL;
+    results->pos_args_only = 0;
 
-    parser->max_pos_args = max_pos_args;
-    parser->pos_args_capacity = ARGPARSER_INITIAL_CAPACITY;
-    if (0 <= max_pos_args && max_pos_args < (intmax_t)parser->pos_args_capacity)
-        parser->pos_args_capacity = max_pos_args;
-    if (!(parser->pos_args =
-              malloc(parser->pos_args_capacity * sizeof *parser->pos_args)))
+    for (int i = 1; i < argc; ++i) {
+        const char *equal_sign;
+        const size_t len =
+            Argparser_scan(results, argv[i], SIZE_MAX, &equal_sign);
+        if (Argparser_recv_token(parser, results, argv[i], len, equal_sign, i,
+                                 0))
+            return 1;
+    }
+    return Argparser_finish_results(parser, results);
+}
+
+int Argparser_parse_results(const Argparser *const parser,
+                            ArgparseResults *const results, const int argc,
+                            const char *const *const argv) {
+    ARGPARSER_TIMER(start);
+    const int ret = Argparser_parse_argv(parser, results, argc, argv);
+    ARGPARSER_ELAPSED(&results->stats, parse_ticks, start);
+    ARGPARSER_COUNT(&results->stats, parses, 1);
+    return ret;
+}
+
+/* Argparser_parse through the cache, see Argparser_set_cache */
+static int Argparser_parse_cached(Argparser *const parser, const int argc,
+                                  const char *const *const argv);
+
+int Argparser_parse(Argparser *const parser, const int argc,
+                    const char *const *const argv) {
+    if (Argparser_alloc_states(parser))
+        return Argparser_fail_alloc(parser, &parser->results, -1);
+    Argparser_build_index(parser, 0);
+    if (parser->cache)
+        return Argparser_parse_cached(parser, argc, argv);
+    return Argparser_parse_results(parser, &parser->results, argc, argv);
+}
+
+int Argparser_feed(Argparser *const parser, const char *const token) {
+    if (Argparser_alloc_states(parser))
+        return Argparser_fail_alloc(parser, &parser->results, -1);
+    Argparser_build_index(parser, 0);
+    const int argv_index =
+        Argparser_add_token(parser, &parser->results, token);
+    if (argv_index < 0)
         return 1;
+    const char *equal_sign;
+    const size_t len =
+        Argparser_scan(&parser->results, token, SIZE_MAX, &equal_sign);
+    return Argparser_recv_token(parser, &parser->results, token, len,
+                                equal_sign, argv_index, 0);
+}
 
+/* Append to the token that was cut off at the end of the previous chunk. It
+ * is kept in blocks owned by the results, which stay valid until reset. */
+static int Argparser_append_partial(const Argparser *const parser,
+                                    ArgparseResults *const results,
+                                    const char *const chunk,
+                                    const size_t len) {
+    struct ArgparseBlock *block = results->blocks;
+    if (!block || block->size - block->used < results->partial_len + len + 1) {
+        size_t size = ARGPARSER_BLOCK_SIZE;
+        while (size < results->partial_len + len + 1)
+            size *= 2;
+        struct ArgparseBlock *new_block;
+        if (!(new_block = Argparser_alloc(results->allocator,
+                                          sizeof *new_block + size)))
+            return Argparser_fail_alloc(parser, results, -1);
+        new_block->next = block;
+        new_block->size = size;
+        new_block->used = 0;
+        /* Move what we have of the token so far */
+        if (block)
+            memcpy(new_block->data, block->data + block->used,
+                   results->partial_len);
+        results->blocks = block = new_block;
+    }
+    memcpy(block->data + block->used + results->partial_len, chunk, len);
+    results->partial_len += len;
     return 0;
 }
 
-static void ArgparseOpt_deinit(ArgparseOpt *const opt) { free(opt->long_opt); }
+/* Feed the token completed by Argparser_append_partial */
+static int Argparser_feed_partial(const Argparser *const parser,
+                                  ArgparseResults *const results) {
+    struct ArgparseBlock *block = results->blocks;
+    char *token = block->data + block->used;
+    const size_t len = results->partial_len;
+    token[len] = '\0';
+    block->used += len + 1;
+    results->partial_len = 0;
 
-void Argparser_deinit(Argparser *const parser) {
-    free(parser->pos_args);
-    for (size_t i = 0; i < parser->num_opts; ++i)
-        ArgparseOpt_deinit(parser->opts + i);
-    free(parser->opts);
+    const int argv_index = Argparser_add_token(parser, results, token);
+    if (argv_index < 0)
+        return 1;
+    /* The pieces were scanned separately, so look for '=' again */
+    ARGPARSER_COUNT(&results->stats, bytes_scanned, len);
+    return Argparser_recv_token(parser, results, token, len,
+                                memchr(token, '=', len), argv_index, 0);
 }
 
-int Argparser_add_argument(Argparser *const parser, const char short_opt,
-                           const char *const long_opt,
-                           const ArgparseType type) {
-    /* Grow the opts array if needed */
-    if (parser->num_opts >= parser->opts_capacity) {
-        ArgparseOpt *new_opts;
-        parser->opts_capacity *= 2;
-        if (!(new_opts = realloc(parser->opts,
-                                 parser->opts_capacity * sizeof *parser->opts)))
-            return 1;
-        parser->opts = new_opts;
+int Argparser_feed_buffer(Argparser *const parser, const char *buf,
+                          const size_t len) {
+    if (Argparser_alloc_states(parser))
+        return Argparser_fail_alloc(parser, &parser->results, -1);
+    Argparser_build_index(parser, 0);
+    ArgparseResults *const results = &parser->results;
+    const char *const end = buf + len;
+    while (buf < end) {
+        const char *equal_sign;
+        const size_t token_len =
+            Argparser_scan(results, buf, (size_t)(end - buf), &equal_sign);
+        if (buf + token_len == end)
+            return Argparser_append_partial(parser, results, buf, token_len);
+
+        if (results->partial_len) {
+            if (Argparser_append_partial(parser, results, buf, token_len) ||
+                Argparser_feed_partial(parser, results))
+                return 1;
+        } else {
+            const int argv_index = Argparser_add_token(parser, results, buf);
+            if (argv_index < 0 ||
+                Argparser_recv_token(parser, results, buf, token_len,
+                                     equal_sign, argv_index, 0))
+                return 1;
+        }
+        buf += token_len + 1;
     }
+    return 0;
+}
 
-    ArgparseOpt *opt = parser->opts + (parser->num_opts++);
-    memset(opt, 0, sizeof *opt);
-    opt->short_opt = short_opt;
-    opt->type = type;
-    if (long_opt) {
-        const size_t len = strlen(long_opt);
-        if (!(opt->long_opt = malloc(len + 1)))
-            return 1;
-        strncpy(opt->long_opt, long_opt, len + 1);
+static int Argparser_finish_results(const Argparser *const parser,
+                                    ArgparseResults *const results) {
+    /* The last token of a buffer need not be terminated */
+    if (results->partial_len && Argparser_feed_partial(parser, results))
+        return 1;
+    results->pos_args_only = 0;
+
+    if (results->pending_opt) {
+        /* We're missing an argument */
+        const ArgparseOpt *opt = results->pending_opt;
+        const int argv_index = results->pending_argv_index;
+        const char *const token = Argparser_results_arg(results, argv_index);
+        results->pending_opt = NULL;
+        return Argparser_fail(parser, results,
+                              (ArgparseError){ARG_ERROR_MISSING_VALUE,
+                                              argv_index, token, strlen(token),
+                                              opt, results->pending_is_long,
+                                              0});
     }
     return 0;
 }
 
-/* Get a pointer to the ArgparseOpt with matching option, otherwise NULL */
-static ArgparseOpt *Argparser_get_opt_ptr(const Argparser *const parser,
-                                          const char short_opt,
-                                          const char *const long_opt) {
-    if (short_opt) {
-        for (size_t i = 0; i < parser->num_opts; ++i)
-            if (short_opt == parser->opts[i].short_opt)
-                return parser->opts + i;
-    } else {
-        for (size_t i = 0; i < parser->num_opts; ++i)
-            if (parser->opts[i].long_opt &&
-                strcmp(long_opt, parser->opts[i].long_opt) == 0)
-                return parser->opts + i;
+int Argparser_finish(Argparser *const parser) {
+    return Argparser_finish_results(parser, &parser->results);
+}
+
+void Argparser_results_reset(const Argparser *const parser,
+                             ArgparseResults *const results) {
+    (void)parser;
+    while (results->touched) {
+        ArgparseOptState *state = results->states + (results->touched - 1);
+        results->touched = state->next_touched;
+        memset(state, 0, sizeof *state);
     }
-    return NULL;
+    results->num_pos_args = results->num_occurrences = 0;
+
+    results->argc = 0;
+    results->argv = NULL;
+    results->num_tokens = 0;
+    ArgparseResults_unmap_files(results);
+    ArgparseResults_free_blocks(results, &results->blocks, 1);
+    ArgparseResults_free_blocks(results, &results->list_blocks, 1);
+    results->partial_len = 0;
+    results->pending_opt = NULL;
+    results->pos_args_only = 0;
+    results->subcommand = 0;
+    memset(&results->error, 0, sizeof results->error);
 }
 
-/* Process a positional argument */
-static int Argparser_recv_pos_arg(Argparser *const parser,
-                                  const int argv_index) {
-    /* Too many positional arguments */
-    if (0 <= parser->max_pos_args &&
-        parser->max_pos_args <= (intmax_t)parser->num_pos_args) {
-        fprintf(stderr,
-                "%s: too many positional arguments (at most %" PRIiMAX ")\n",
-                parser->prog_name, parser->max_pos_args);
+void Argparser_reset(Argparser *const parser) {
+    const size_t subcommand = parser->results.subcommand;
+    Argparser_results_reset(parser, &parser->results);
+    if (subcommand && subcommand == parser->loaded_subcommand)
+        Argparser_hide_subcommand_opts(parser);
+    else if (subcommand)
+        Argparser_drop_subcommand_opts(parser);
+}
+
+int Argparser_results_init(const Argparser *const parser,
+                           ArgparseResults *const results) {
+    memset(results, 0, sizeof *results);
+    results->allocator = parser->allocator;
+    /* Every option needs a state, even if there are none */
+    if (!(results->states = Argparser_calloc(
+              results->allocator,
+              (parser->num_opts + 1) * sizeof *results->states)))
+        return 1;
+    if (ArgparseResults_init_pos_args(results, parser->max_pos_args)) {
+        Argparser_free(results->allocator, results->states);
         return 1;
     }
+    return 0;
+}
 
-    /* Grow the pos_args array if needed */
-    if (parser->num_pos_args >= parser->pos_args_capacity) {
-        int *new_pos_args;
-        parser->pos_args_capacity *= 2;
-        if (0 <= parser->max_pos_args &&
-            parser->max_pos_args < (intmax_t)parser->pos_args_capacity)
-            parser->pos_args_capacity = parser->max_pos_args;
-        if (!(new_pos_args =
-                  realloc(parser->pos_args, parser->pos_args_capacity *
-                                                sizeof *parser->pos_args))) {
-            fprintf(stderr,
-                    "%s: allocation failed in function %s, line %d of %s\n",
-                    parser->prog_name, __func__, __LINE__, __FILE__);
-            return 1;
+void Argparser_results_deinit(ArgparseResults *const results) {
+    ArgparseResults_release(results);
+    Argparser_free(results->allocator, results->pos_args);
+    Argparser_free(results->allocator, results->states);
+}
+
+void Argparser_results_view(const Argparser *const parser,
+                            const ArgparseResults *const results,
+                            Argparser *const view) {
+    *view = *parser;
+    view->results = *results;
+}
+
+typedef struct ArgparseBatch {
+    const Argparser *parser;
+    ArgparseJob *jobs;
+    size_t num_jobs, next_job;
+    int failed;
+} ArgparseBatch;
+
+static void *Argparser_batch_worker(void *const arg) {
+    ArgparseBatch *const batch = arg;
+    for (;;) {
+        const size_t i =
+            __atomic_fetch_add(&batch->next_job, 1, __ATOMIC_RELAXED);
+        if (i >= batch->num_jobs)
+            return NULL;
+        ArgparseJob *const job = batch->jobs + i;
+        Argparser_results_reset(batch->parser, job->results);
+        if ((job->status = Argparser_parse_results(batch->parser, job->results,
+                                                   job->argc, job->argv)))
+            __atomic_store_n(&batch->failed, 1, __ATOMIC_RELAXED);
+    }
+}
+
+int Argparser_parse_batch(const Argparser *const parser,
+                          ArgparseJob *const jobs, const size_t num_jobs,
+                          unsigned num_threads) {
+    ArgparseBatch batch = {parser, jobs, num_jobs, 0, 0};
+    if (!num_threads) {
+        const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = num_cpus > 0 ? (unsigned)num_cpus : 1;
+    }
+    if (num_threads > num_jobs)
+        num_threads = num_jobs ? (unsigned)num_jobs : 1;
+
+    /* The calling thread is one of the workers */
+    pthread_t *threads = NULL;
+    int ret = 0;
+    if (num_threads > 1 &&
+        !(threads = Argparser_alloc(parser->allocator,
+                                    (num_threads - 1) * sizeof *threads))) {
+        /* Do the work on the calling thread alone */
+        num_threads = 1;
+        ret = 1;
+    }
+    unsigned num_started = 0;
+    for (; num_started + 1 < num_threads; ++num_started) {
+        if (pthread_create(threads + num_started, NULL, Argparser_batch_worker,
+                           &batch)) {
+            /* Carry on with the threads we have */
+            ret = 1;
+            break;
         }
-        parser->pos_args = new_pos_args;
     }
+    Argparser_batch_worker(&batch);
+    for (unsigned i = 0; i < num_started; ++i)
+        pthread_join(threads[i], NULL);
+    Argparser_free(parser->allocator, threads);
+    return ret || batch.failed;
+}
 
-    parser->pos_args[parser->num_pos_args++] = argv_index;
-    return 0;
+/*
+ * Snapshots. All offsets are relative to the start of the blob, which holds
+ * a header, the states of the options that occurred, the occurrences, the
+ * positional arguments, the items of list options, the offsets of all tokens
+ * and the tokens themselves. Records are copied with memcpy, so the blob need
+ * not be aligned.
+ */
+#define ARGPARSER_SNAPSHOT_MAGIC 0x32535041u /* "APS2" */
+
+struct ArgparseSnapshotHeader {
+    uint32_t magic, subcommand;
+    uint64_t size, num_opts, num_states, num_occurrences, num_pos_args,
+        num_item_words, num_tokens;
+};
+
+/* The items of a list option follow those of the states before it, one word
+ * each, or for ARG_STR_LIST an offset into the value and a length */
+struct ArgparseSnapshotState {
+    uint64_t opt_index, begin, val_strlen, first_occurrence, last_occurrence,
+        num_items;
+    int32_t count, argv_index, conversion;
+    uintmax_t value;
+};
+
+struct ArgparseSnapshotOccurrence {
+    uint64_t begin, val_strlen, next;
+    int32_t argv_index;
+    uintmax_t value;
+};
+
+/* Where each part of a snapshot starts */
+struct ArgparseSnapshotLayout {
+    size_t states, occurrences, pos_args, items, tokens, strings;
+};
+
+static void
+Argparser_snapshot_layout(const struct ArgparseSnapshotHeader *const h,
+                          struct ArgparseSnapshotLayout *const layout) {
+    layout->states = sizeof *h;
+    layout->occurrences =
+        layout->states + h->num_states * sizeof(struct ArgparseSnapshotState);
+    layout->pos_args =
+        layout->occurrences +
+        h->num_occurrences * sizeof(struct ArgparseSnapshotOccurrence);
+    layout->items = layout->pos_args + h->num_pos_args * sizeof(int32_t);
+    layout->tokens = layout->items + h->num_item_words * sizeof(uint64_t);
+    layout->strings = layout->tokens + h->num_tokens * sizeof(uint64_t);
 }
 
-static int Argparser_handle_opt(Argparser *const parser, ArgparseOpt *const opt,
-                                const char *const val, const size_t val_strlen,
-                                const int is_long_opt) {
-    if (opt->type == ARG_STR)
+/* Words that the items of a list option take in a snapshot */
+static size_t Argparser_snapshot_item_words(const ArgparseOpt *const opt,
+                                            const size_t num_items) {
+    if (!Argparser_is_list(opt->type))
         return 0;
+    return opt->type == ARG_STR_LIST ? 2 * num_items : num_items;
+}
 
-    /* For error messages */
-    const char *dashes = is_long_opt ? "--" : "-";
-    const char short_opt_str[2] = {opt->short_opt, '\0'};
-    const char *opt_str = is_long_opt ? opt->long_opt : short_opt_str;
+/* Fill in the header of a snapshot of the parser's results */
+static void
+Argparser_snapshot_header(const Argparser *const parser,
+                          struct ArgparseSnapshotHeader *const h) {
+    const ArgparseResults *const results = &parser->results;
+    memset(h, 0, sizeof *h);
+    h->magic = ARGPARSER_SNAPSHOT_MAGIC;
+    h->subcommand = (uint32_t)results->subcommand;
+    h->num_opts = parser->num_opts;
+    for (size_t i = results->touched; i;) {
+        const ArgparseOptState *const state = results->states + (i - 1);
+        ++h->num_states;
+        h->num_item_words += Argparser_snapshot_item_words(
+            parser->opts + i - 1, state->num_items);
+        i = state->next_touched;
+    }
+    h->num_occurrences = results->num_occurrences;
+    h->num_pos_args = results->num_pos_args;
+    h->num_tokens = (size_t)results->argc + results->num_tokens;
 
-    char *endptr;
-    switch (opt->type) {
-    case ARG_INT:
-        opt->int_val = strtoimax(val, &endptr, 10);
-        if (isspace(val[0]) /* strtoimax discards leading whitespaces*/ ||
-            endptr == val || (size_t)(endptr - val) != val_strlen) {
-            /* No conversion, or val is not consumed fully */
-            fprintf(stderr,
-                    "%s: argument '%s' for option '%s%s' is not a valid "
-                    "integer\n",
-                    parser->prog_name, val, dashes, opt_str);
-            return 1;
+    size_t strings_size = 0;
+    for (size_t i = 0; i < h->num_tokens; ++i)
+        strings_size += strlen(Argparser_arg(parser, (int)i)) + 1;
+    struct ArgparseSnapshotLayout layout;
+    Argparser_snapshot_layout(h, &layout);
+    h->size = layout.strings + strings_size;
+}
+
+size_t Argparser_snapshot_size(const Argparser *const parser) {
+    struct ArgparseSnapshotHeader h;
+    Argparser_snapshot_header(parser, &h);
+    return h.size;
+}
+
+/* Offset in the blob of a span within the token at argv_index */
+static uint64_t Argparser_snapshot_span(const Argparser *const parser,
+                                        const char *const blob,
+                                        const size_t tokens,
+                                        const int argv_index,
+                                        const char *const begin) {
+    uint64_t offset;
+    memcpy(&offset, blob + tokens + (size_t)argv_index * sizeof offset,
+           sizeof offset);
+    return offset + (uint64_t)(begin - Argparser_arg(parser, argv_index));
+}
+
+int Argparser_snapshot(const Argparser *const parser, void *const buf,
+                       const size_t size) {
+    const ArgparseResults *const results = &parser->results;
+    struct ArgparseSnapshotHeader h;
+    struct ArgparseSnapshotLayout layout;
+    Argparser_snapshot_header(parser, &h);
+    if (size < h.size)
+        return 1;
+    Argparser_snapshot_layout(&h, &layout);
+    char *const blob = buf;
+    memcpy(blob, &h, sizeof h);
+
+    /* Tokens come first, as spans are located through them */
+    size_t offset = layout.strings;
+    for (size_t i = 0; i < h.num_tokens; ++i) {
+        const char *const token = Argparser_arg(parser, (int)i);
+        const size_t len = strlen(token) + 1;
+        const uint64_t token_offset = offset;
+        memcpy(blob + layout.tokens + i * sizeof token_offset, &token_offset,
+               sizeof token_offset);
+        memcpy(blob + offset, token, len);
+        offset += len;
+    }
+
+    char *rec = blob + layout.states, *item = blob + layout.items;
+    for (size_t i = results->touched; i;) {
+        const ArgparseOpt *const opt = parser->opts + i - 1;
+        ArgparseOptState state = results->states[i - 1];
+        struct ArgparseSnapshotState s;
+        /* Workers should not have to convert anything */
+        if (state.conversion == ARG_CONVERSION_PENDING)
+            state.conversion = Argparser_convert_value(
+                parser, opt, &state, state.begin, state.val_strlen);
+        memset(&s, 0, sizeof s);
+        s.opt_index = i - 1;
+        s.begin = Argparser_snapshot_span(parser, blob, layout.tokens,
+                                          state.argv_index, state.begin);
+        s.val_strlen = state.val_strlen;
+        s.first_occurrence = state.first_occurrence;
+        s.last_occurrence = state.last_occurrence;
+        s.count = state.count;
+        s.argv_index = state.argv_index;
+        s.conversion = state.conversion;
+        memcpy(&s.value, &state.uint_val, sizeof s.value);
+        if (Argparser_is_list(opt->type)) {
+            s.num_items = state.num_items;
+            memset(&s.value, 0, sizeof s.value);
         }
-        return 0;
-    case ARG_FLOAT:
-        opt->float_val = strtod(val, &endptr);
-        if (isspace(val[0]) /* strtod discards leading whitespaces*/ ||
-            endptr == val || (size_t)(endptr - val) != val_strlen) {
-            /* No conversion, or val is not consumed fully */
-            fprintf(stderr,
-                    "%s: argument '%s' for option '%s%s' is not a valid "
-                    "floating point number\n",
-                    parser->prog_name, val, dashes, opt_str);
-            return 1;
+        memcpy(rec, &s, sizeof s);
+        rec += sizeof s;
+        for (size_t j = 0; j < s.num_items; ++j) {
+            uint64_t words[2];
+            if (opt->type == ARG_STR_LIST) {
+                const ArgparseSpan *const span =
+                    (const ArgparseSpan *)state.items + j;
+                words[0] = (uint64_t)(span->begin - state.begin);
+                words[1] = span->len;
+            } else if (opt->type == ARG_INT_LIST) {
+                words[0] = (uint64_t)((const intmax_t *)state.items)[j];
+            } else {
+                memcpy(words, (const double *)state.items + j, sizeof(double));
+            }
+            const size_t size =
+                Argparser_snapshot_item_words(opt, 1) * sizeof *words;
+            memcpy(item, words, size);
+            item += size;
         }
-        return 0;
-    default:
-        fprintf(stderr, "%s: internal error in function %s, line %d of %s\n",
-                parser->prog_name, __func__, __LINE__, __FILE__);
+        i = state.next_touched;
+    }
+
+    for (size_t i = 0; i < h.num_occurrences; ++i) {
+        const ArgparseOccurrence *const occ = results->occurrences + i;
+        struct ArgparseSnapshotOccurrence o;
+        memset(&o, 0, sizeof o);
+        o.begin = Argparser_snapshot_span(parser, blob, layout.tokens,
+                                          occ->argv_index, occ->begin);
+        o.val_strlen = occ->val_strlen;
+        o.next = occ->next;
+        o.argv_index = occ->argv_index;
+        memcpy(&o.value, &occ->uint_val, sizeof o.value);
+        memcpy(rec, &o, sizeof o);
+        rec += sizeof o;
+    }
+
+    for (size_t i = 0; i < h.num_pos_args; ++i) {
+        const int32_t argv_index = results->pos_args[i];
+        memcpy(rec, &argv_index, sizeof argv_index);
+        rec += sizeof argv_index;
+    }
+    return 0;
+}
+
+/* Whether a span of a snapshot lies within its strings */
+static int
+Argparser_snapshot_span_ok(const struct ArgparseSnapshotHeader *const h,
+                           const struct ArgparseSnapshotLayout *const layout,
+                           const uint64_t begin, const uint64_t len) {
+    return begin >= layout->strings && begin <= h->size &&
+           len <= h->size - begin;
+}
+
+/* Copy the items of a list option out of a snapshot */
+static int Argparser_load_snapshot_items(
+    ArgparseResults *const results, const ArgparseOpt *const opt,
+    ArgparseOptState *const state, const struct ArgparseSnapshotState *const s,
+    const char **const item, uint64_t *const item_words) {
+    const size_t words_per_item = Argparser_snapshot_item_words(opt, 1);
+    if (s->num_items > *item_words / words_per_item)
+        return 1;
+    const size_t num_items = (size_t)s->num_items;
+    char *items = NULL;
+    if (num_items &&
+        !(items = Argparser_alloc_items(
+              results, num_items * Argparser_item_size(opt->type))))
         return 1;
+    for (size_t i = 0; i < num_items; ++i) {
+        uint64_t words[2];
+        memcpy(words, *item, words_per_item * sizeof *words);
+        *item += words_per_item * sizeof *words;
+        if (opt->type == ARG_STR_LIST) {
+            if (words[0] > state->val_strlen ||
+                words[1] > state->val_strlen - words[0])
+                return 1;
+            ((ArgparseSpan *)items)[i].begin = state->begin + words[0];
+            ((ArgparseSpan *)items)[i].len = (size_t)words[1];
+        } else if (opt->type == ARG_INT_LIST) {
+            ((intmax_t *)items)[i] = (intmax_t)words[0];
+        } else {
+            memcpy((double *)items + i, words, sizeof(double));
+        }
     }
+    *item_words -= num_items * words_per_item;
+    state->items = items;
+    state->num_items = num_items;
+    return 0;
 }
 
-static int Argparser_recv_short_opt(Argparser *const parser, const int argc,
-                                    const char *const *const argv,
-                                    int *const argv_index, const size_t i) {
-    const char short_opt = argv[*argv_index][i];
-    const int is_last_char = argv[*argv_index][i + 1] == '\0';
-    ArgparseOpt *opt;
-    if (!(opt = Argparser_get_opt_ptr(parser, short_opt, NULL))) {
-        fprintf(stderr, "%s: unknown option '-%c'\n", parser->prog_name,
-                short_opt);
+static int
+Argparser_load_snapshot_results(Argparser *const parser, const char *const blob,
+                                const struct ArgparseSnapshotHeader *const h) {
+    ArgparseResults *const results = &parser->results;
+    struct ArgparseSnapshotLayout layout;
+    Argparser_snapshot_layout(h, &layout);
+
+    /* Tokens must be terminated within the blob */
+    if (h->num_tokens > INT_MAX ||
+        (h->num_tokens && blob[h->size - 1] != '\0'))
         return 1;
+    for (size_t i = 0; i < h->num_tokens; ++i) {
+        uint64_t offset;
+        memcpy(&offset, blob + layout.tokens + i * sizeof offset,
+               sizeof offset);
+        if (!Argparser_snapshot_span_ok(h, &layout, offset, 1) ||
+            Argparser_add_token(parser, results, blob + offset) < 0)
+            return 1;
     }
 
-    if (opt->type == ARG_BOOL) {
-        /* Option doesn't take an argument */
-        ++opt->count;
-        opt->argv_index = *argv_index;
-        opt->begin = argv[*argv_index] + i;
-        if (is_last_char)
-            return 0;
-        /* Look at the rest of the characters */
-        return Argparser_recv_short_opt(parser, argc, argv, argv_index, i + 1);
+    const char *rec = blob + layout.states, *item = blob + layout.items;
+    uint64_t item_words = h->num_item_words;
+    for (size_t i = 0; i < h->num_states;
+         ++i, rec += sizeof(struct ArgparseSnapshotState)) {
+        struct ArgparseSnapshotState s;
+        memcpy(&s, rec, sizeof s);
+        if (s.opt_index >= parser->num_opts || s.count <= 0 ||
+            s.argv_index < 0 || (uint64_t)s.argv_index >= h->num_tokens ||
+            !Argparser_snapshot_span_ok(h, &layout, s.begin, s.val_strlen) ||
+            s.first_occurrence > h->num_occurrences ||
+            s.last_occurrence > h->num_occurrences || s.conversion < 0 ||
+            s.conversion > ARG_CONVERSION_NO_MEMORY)
+            return 1;
+        const ArgparseOpt *const opt = parser->opts + s.opt_index;
+        if ((s.num_items && !Argparser_is_list(opt->type)) ||
+            ((s.first_occurrence || s.last_occurrence) &&
+             !(opt->flags & ARG_FLAG_ACCUMULATE)))
+            return 1;
+        ArgparseOptState *const state = results->states + (size_t)s.opt_index;
+        if (state->count)
+            return 1;
+        state->begin = blob + s.begin;
+        state->val_strlen = (size_t)s.val_strlen;
+        state->count = s.count;
+        state->argv_index = s.argv_index;
+        state->conversion = (ArgparseConversion)s.conversion;
+        memcpy(&state->uint_val, &s.value, sizeof s.value);
+        state->first_occurrence = (size_t)s.first_occurrence;
+        state->last_occurrence = (size_t)s.last_occurrence;
+        state->next_touched = results->touched;
+        results->touched = (size_t)s.opt_index + 1;
+        if (Argparser_is_list(opt->type) &&
+            Argparser_load_snapshot_items(results, opt, state, &s, &item,
+                                          &item_words))
+            return 1;
+        if (opt->dest)
+            Argparser_store(opt, state);
+    }
+    if (item_words)
+        return 1;
+
+    while (results->occurrences_capacity < h->num_occurrences) {
+        ArgparseOccurrence *new_occurrences;
+        if (!(new_occurrences = Argparser_grow(
+                  results->allocator, results->occurrences,
+                  &results->occurrences_capacity,
+                  sizeof *results->occurrences)))
+            return 1;
+        results->occurrences = new_occurrences;
+    }
+    for (size_t i = 0; i < h->num_occurrences;
+         ++i, rec += sizeof(struct ArgparseSnapshotOccurrence)) {
+        struct ArgparseSnapshotOccurrence o;
+        memcpy(&o, rec, sizeof o);
+        /* Chains only point forward, as occurrences are in argv order, so
+         * Argparser_next_occurrence cannot loop */
+        if (o.next > h->num_occurrences || (o.next && o.next <= i + 1) ||
+            o.argv_index < 0 || (uint64_t)o.argv_index >= h->num_tokens ||
+            !Argparser_snapshot_span_ok(h, &layout, o.begin, o.val_strlen))
+            return 1;
+        ArgparseOccurrence *const occ = results->occurrences + i;
+        occ->begin = blob + o.begin;
+        occ->val_strlen = (size_t)o.val_strlen;
+        occ->argv_index = o.argv_index;
+        occ->next = (size_t)o.next;
+        memcpy(&occ->uint_val, &o.value, sizeof o.value);
     }
+    results->num_occurrences = (size_t)h->num_occurrences;
 
-    const size_t val_strlen = is_last_char ? strlen(argv[++*argv_index])
-                                           : strlen(argv[*argv_index]) - i - 1;
-    const char *begin = argv[*argv_index] + (is_last_char ? 0 : i + 1);
-    if (Argparser_handle_opt(parser, opt, begin, val_strlen, 0))
+    for (size_t i = 0; i < h->num_pos_args; ++i, rec += sizeof(int32_t)) {
+        int32_t argv_index;
+        memcpy(&argv_index, rec, sizeof argv_index);
+        if (argv_index < 0 || (uint64_t)argv_index >= h->num_tokens ||
+            Argparser_recv_pos_arg(parser, results,
+                                   Argparser_results_arg(results, argv_index),
+                                   argv_index))
+            return 1;
+    }
+    return 0;
+}
+
+int Argparser_load_snapshot(Argparser *const parser, const void *const blob,
+                            const size_t size) {
+    struct ArgparseSnapshotHeader h;
+    struct ArgparseSnapshotLayout layout;
+    Argparser_reset(parser);
+    if (Argparser_alloc_states(parser) || size < sizeof h)
+        return 1;
+    memcpy(&h, blob, sizeof h);
+    /* Guard the layout computation against overflow before using it */
+    const uint64_t max_records = size / sizeof(struct ArgparseSnapshotState);
+    if (h.magic != ARGPARSER_SNAPSHOT_MAGIC || h.size != size ||
+        h.num_states > max_records || h.num_occurrences > max_records ||
+        h.num_pos_args > size || h.num_item_words > size ||
+        h.num_tokens > size)
         return 1;
-    opt->argv_index = *argv_index;
-    opt->begin = begin;
-    opt->val_strlen = val_strlen;
-    ++opt->count;
+    Argparser_snapshot_layout(&h, &layout);
+    if (layout.strings > size || h.subcommand > parser->num_subcommands)
+        return 1;
+
+    /* The snapshot's subcommand adds its options, as in the original parse */
+    if (h.subcommand) {
+        const ArgparseSubcommand *const subcommand =
+            parser->subcommands + h.subcommand - 1;
+        if (Argparser_select_subcommand(parser, &parser->results,
+                                        subcommand->name,
+                                        strlen(subcommand->name), -1))
+            goto load_snapshot_fail;
+    }
+    if (h.num_opts != parser->num_opts ||
+        Argparser_load_snapshot_results(parser, blob, &h))
+        goto load_snapshot_fail;
     return 0;
+
+load_snapshot_fail:
+    Argparser_reset(parser);
+    return 1;
 }
 
-static int Argparser_recv_long_opt(Argparser *const parser, const int argc,
-                                   const char *const *const argv,
-                                   int *const argv_index) {
-    const char *opt_name = argv[*argv_index] + 2;
-    int has_equal_sign = 0;
-    size_t opt_end_index;
-    for (opt_end_index = 2;; ++opt_end_index) {
-        if (argv[*argv_index][opt_end_index] == '=') {
-            has_equal_sign = 1;
-            break;
-        } else if (argv[*argv_index][opt_end_index] == '\0') {
-            has_equal_sign = 0;
-            break;
+/*
+ * Parse result cache, see Argparser_set_cache. Entries are chained into a
+ * hash table and kept in a list from the most to the least recently used.
+ * Links are entry indices plus one, with 0 for none.
+ */
+
+/* Results of one option, with its span as an offset into its token */
+struct ArgparseCachedState {
+    size_t opt_index, offset;
+    ArgparseOptState state;
+};
+
+struct ArgparseCachedOccurrence {
+    size_t offset;
+    ArgparseOccurrence occ;
+};
+
+struct ArgparseCacheEntry {
+    uint64_t hash;
+    uint32_t next_in_bucket, newer, older;
+    int argc;
+    unsigned flags;
+    size_t num_opts, subcommand, touched;
+    size_t num_states, items_size, num_occurrences, num_pos_args;
+    /* The states, the items of list options, with ARG_STR_LIST items as
+     * offsets into the value, the occurrences, positional arguments, token
+     * lengths and the tokens after argv[0], each '\0'-terminated */
+    char *data;
+    size_t data_capacity;
+};
+
+struct ArgparseCache {
+    size_t max_entries, num_entries, bucket_mask;
+    uint32_t newest, oldest;
+    uint32_t *buckets;
+    struct ArgparseCacheEntry entries[];
+};
+
+/* Where each part of the data of an entry starts */
+struct ArgparseCacheLayout {
+    size_t items, occurrences, pos_args, lens, tokens;
+};
+
+static void
+Argparser_cache_layout(const struct ArgparseCacheEntry *const entry,
+                       struct ArgparseCacheLayout *const layout) {
+    layout->items = entry->num_states * sizeof(struct ArgparseCachedState);
+    layout->occurrences = layout->items + entry->items_size;
+    layout->pos_args =
+        layout->occurrences +
+        entry->num_occurrences * sizeof(struct ArgparseCachedOccurrence);
+    layout->lens = layout->pos_args + entry->num_pos_args * sizeof(int);
+    layout->tokens =
+        layout->lens + (size_t)(entry->argc - 1) * sizeof(uint32_t);
+}
+
+int Argparser_set_cache(Argparser *const parser, const size_t max_entries) {
+    Argparser_clear_cache(parser);
+    Argparser_free(parser->allocator, parser->cache);
+    parser->cache = NULL;
+    if (!max_entries)
+        return 0;
+    if (max_entries >= UINT32_MAX / 2)
+        return 1;
+
+    /* At most one entry per bucket on average. The buckets follow the
+     * entries in the same allocation. */
+    size_t num_buckets = 1;
+    while (num_buckets < max_entries)
+        num_buckets *= 2;
+    const size_t buckets_offset =
+        sizeof(struct ArgparseCache) +
+        max_entries * sizeof(struct ArgparseCacheEntry);
+    struct ArgparseCache *const cache = Argparser_calloc(
+        parser->allocator, buckets_offset + num_buckets * sizeof(uint32_t));
+    if (!cache)
+        return 1;
+    cache->max_entries = max_entries;
+    cache->bucket_mask = num_buckets - 1;
+    cache->buckets = (uint32_t *)((char *)cache + buckets_offset);
+    parser->cache = cache;
+    return 0;
+}
+
+void Argparser_clear_cache(Argparser *const parser) {
+    struct ArgparseCache *const cache = parser->cache;
+    if (!cache)
+        return;
+    for (size_t i = 0; i < cache->num_entries; ++i)
+        Argparser_free(parser->allocator, cache->entries[i].data);
+    memset(cache->entries, 0, cache->num_entries * sizeof *cache->entries);
+    memset(cache->buckets, 0,
+           (cache->bucket_mask + 1) * sizeof *cache->buckets);
+    cache->num_entries = 0;
+    cache->newest = cache->oldest = 0;
+}
+
+/* Hash the tokens after argv[0]. Only the length and both ends of each token
+ * are mixed in, as entries are compared in full anyway. Fails if the tokens
+ * take more than ARGPARSER_CACHE_MAX_BYTES. */
+static int Argparser_hash_argv(const int argc, const char *const *const argv,
+                               uint64_t *const hash) {
+    const uint64_t k = 0x9e3779b97f4a7c15u;
+    uint64_t h = (uint64_t)argc * k;
+    size_t size = 0;
+    for (int i = 1; i < argc; ++i) {
+        const unsigned char *const s = (const unsigned char *)argv[i];
+        const size_t len = strlen(argv[i]);
+        if ((size += len + 1) > ARGPARSER_CACHE_MAX_BYTES)
+            return 1;
+        uint64_t head = 0, tail = 0;
+        if (len >= 8) {
+            memcpy(&head, s, 8);
+            memcpy(&tail, s + len - 8, 8);
+        } else if (len >= 4) {
+            uint32_t word;
+            memcpy(&word, s, 4);
+            head = word;
+            memcpy(&word, s + len - 4, 4);
+            tail = word;
+        } else if (len) {
+            head = (uint64_t)s[0] << 16 | (uint64_t)s[len / 2] << 8 |
+                   s[len - 1];
         }
+        h = (h ^ len) * k;
+        h = (h ^ head) * k;
+        h = (h ^ tail) * k;
+        h ^= h >> 32;
     }
+    *hash = h;
+    return 0;
+}
 
-    ArgparseOpt *opt = NULL;
-    if (has_equal_sign) {
-        /* opt_name is *not* NULL-terminated */
-        for (size_t j = 0; j < parser->num_opts; ++j) {
-            const char *long_opt = parser->opts[j].long_opt;
-            if (long_opt &&
-                strncmp(long_opt, opt_name, opt_end_index - 2) == 0 &&
-                long_opt[opt_end_index - 2] == '\0') {
-                opt = parser->opts + j;
-                break;
-            }
-        }
-    } else {
-        opt = Argparser_get_opt_ptr(parser, '\0', opt_name);
+/* Take entry i out of the recency list */
+static void Argparser_cache_unlink(struct ArgparseCache *const cache,
+                                   const uint32_t i) {
+    struct ArgparseCacheEntry *const entry = cache->entries + i - 1;
+    if (entry->newer)
+        cache->entries[entry->newer - 1].older = entry->older;
+    else
+        cache->newest = entry->older;
+    if (entry->older)
+        cache->entries[entry->older - 1].newer = entry->newer;
+    else
+        cache->oldest = entry->newer;
+}
+
+/* Put entry i at the front of the recency list */
+static void Argparser_cache_push(struct ArgparseCache *const cache,
+                                 const uint32_t i) {
+    struct ArgparseCacheEntry *const entry = cache->entries + i - 1;
+    entry->newer = 0;
+    entry->older = cache->newest;
+    if (cache->newest)
+        cache->entries[cache->newest - 1].newer = i;
+    else
+        cache->oldest = i;
+    cache->newest = i;
+}
+
+/* Find the entry for a command line, making it the most recently used.
+ * Returns its index plus one, or 0. */
+static uint32_t Argparser_cache_find(const Argparser *const parser,
+                                     const uint64_t hash, const int argc,
+                                     const char *const *const argv) {
+    struct ArgparseCache *const cache = parser->cache;
+    for (uint32_t i = cache->buckets[hash & cache->bucket_mask]; i;
+         i = cache->entries[i - 1].next_in_bucket) {
+        const struct ArgparseCacheEntry *const entry = cache->entries + i - 1;
+        if (entry->hash != hash || entry->argc != argc ||
+            entry->flags != parser->flags)
+            continue;
+        struct ArgparseCacheLayout layout;
+        Argparser_cache_layout(entry, &layout);
+        const uint32_t *const lens =
+            (const uint32_t *)(entry->data + layout.lens);
+        const char *token = entry->data + layout.tokens;
+        int j = 1;
+        for (; j < argc && strcmp(token, argv[j]) == 0; ++j)
+            token += lens[j - 1] + 1;
+        if (j < argc)
+            continue;
+        Argparser_cache_unlink(cache, i);
+        Argparser_cache_push(cache, i);
+        return i;
     }
-    if (!opt) {
-        fprintf(stderr, "%s: unknown option '--%.*s'\n", parser->prog_name,
-                (int)opt_end_index - 2, opt_name);
-        return 1;
+    return 0;
+}
+
+/* Remember the results of parsing a command line, replacing the least
+ * recently used entry if the cache is full. Failure only loses the entry. */
+static void Argparser_cache_insert(Argparser *const parser, const uint64_t hash,
+                                   const int argc,
+                                   const char *const *const argv) {
+    const ArgparseResults *const results = &parser->results;
+    struct ArgparseCache *const cache = parser->cache;
+    struct ArgparseCacheEntry new_entry;
+    memset(&new_entry, 0, sizeof new_entry);
+    new_entry.hash = hash;
+    new_entry.argc = argc;
+    new_entry.flags = parser->flags;
+    new_entry.num_opts = parser->num_opts;
+    new_entry.subcommand = results->subcommand;
+    new_entry.touched = results->touched;
+    for (size_t i = results->touched; i;) {
+        const ArgparseType type = parser->opts[i - 1].type;
+        const ArgparseOptState *const state = results->states + (i - 1);
+        ++new_entry.num_states;
+        if (Argparser_is_list(type))
+            new_entry.items_size +=
+                state->num_items * Argparser_item_size(type);
+        i = state->next_touched;
     }
-    /* opt_name is NULL-terminated from now on */
-    opt_name = opt->long_opt;
+    new_entry.num_occurrences = results->num_occurrences;
+    new_entry.num_pos_args = results->num_pos_args;
 
-    const char *begin = NULL;
-    size_t val_strlen = 0;
-    if (opt->type == ARG_BOOL) {
-        if (has_equal_sign) {
-            fprintf(stderr, "%s: option '--%s' does not take an argument\n",
-                    parser->prog_name, opt_name);
-            return 1;
-        }
-        opt->begin = argv[*argv_index] + 2;
+    struct ArgparseCacheLayout layout;
+    Argparser_cache_layout(&new_entry, &layout);
+    size_t size = layout.tokens;
+    for (int i = 1; i < argc; ++i) {
+        const size_t len = strlen(argv[i]);
+        if (len > UINT32_MAX)
+            return;
+        size += len + 1;
+    }
+
+    /* Take a free entry, or else the least recently used one, but only
+     * once its data fits */
+    const uint32_t i = cache->num_entries < cache->max_entries
+                           ? (uint32_t)cache->num_entries + 1
+                           : cache->oldest;
+    struct ArgparseCacheEntry *const entry = cache->entries + i - 1;
+    new_entry.data = entry->data;
+    new_entry.data_capacity = entry->data_capacity;
+    if (new_entry.data_capacity < size) {
+        if (!(new_entry.data = Argparser_alloc(parser->allocator, size)))
+            return;
+        Argparser_free(parser->allocator, entry->data);
+        new_entry.data_capacity = size;
+    }
+    if (i <= cache->num_entries) {
+        uint32_t *link = cache->buckets + (entry->hash & cache->bucket_mask);
+        while (*link != i)
+            link = &cache->entries[*link - 1].next_in_bucket;
+        *link = entry->next_in_bucket;
+        Argparser_cache_unlink(cache, i);
     } else {
-        if (has_equal_sign) {
-            /* Value is after the equal sign */
-            ++opt_end_index;
-            val_strlen = strlen(argv[*argv_index]) - opt_end_index;
-            begin = argv[*argv_index] + opt_end_index;
+        ++cache->num_entries;
+    }
+    *entry = new_entry;
+
+    char *const data = entry->data;
+    struct ArgparseCachedState *cached =
+        (struct ArgparseCachedState *)data;
+    char *items = data + layout.items;
+    for (size_t j = results->touched; j; ++cached) {
+        const ArgparseOpt *const opt = parser->opts + j - 1;
+        const ArgparseOptState *const state = results->states + (j - 1);
+        cached->opt_index = j - 1;
+        cached->offset = (size_t)(state->begin - argv[state->argv_index]);
+        cached->state = *state;
+        if (Argparser_is_list(opt->type)) {
+            const size_t size =
+                state->num_items * Argparser_item_size(opt->type);
+            if (size)
+                memcpy(items, state->items, size);
+            /* Spans are kept relative to the value */
+            if (opt->type == ARG_STR_LIST)
+                for (size_t k = 0; k < state->num_items; ++k) {
+                    ArgparseSpan *const span = (ArgparseSpan *)items + k;
+                    span->begin = (const char *)(uintptr_t)(span->begin -
+                                                            state->begin);
+                }
+            items += size;
         }
-        /* Increment the index to look for the argument */
-        else if (++(*argv_index) >= argc) {
-            /* We're missing an argument */
-            fprintf(stderr, "%s: missing argument for option '--%s'\n",
-                    parser->prog_name, opt_name);
+        j = state->next_touched;
+    }
+    struct ArgparseCachedOccurrence *cached_occ =
+        (struct ArgparseCachedOccurrence *)(data + layout.occurrences);
+    for (size_t j = 0; j < results->num_occurrences; ++j, ++cached_occ) {
+        const ArgparseOccurrence *const occ = results->occurrences + j;
+        cached_occ->offset = (size_t)(occ->begin - argv[occ->argv_index]);
+        cached_occ->occ = *occ;
+    }
+    memcpy(data + layout.pos_args, results->pos_args,
+           results->num_pos_args * sizeof *results->pos_args);
+    uint32_t *const lens = (uint32_t *)(data + layout.lens);
+    char *token = data + layout.tokens;
+    for (int j = 1; j < argc; ++j) {
+        const size_t len = strlen(argv[j]);
+        lens[j - 1] = (uint32_t)len;
+        memcpy(token, argv[j], len + 1);
+        token += len + 1;
+    }
+
+    uint32_t *const bucket = cache->buckets + (hash & cache->bucket_mask);
+    entry->next_in_bucket = *bucket;
+    *bucket = i;
+    Argparser_cache_push(cache, i);
+}
+
+/* Make the results of entry those of the parser, with spans in argv */
+static int Argparser_cache_restore(Argparser *const parser,
+                                   const struct ArgparseCacheEntry *const entry,
+                                   const int argc,
+                                   const char *const *const argv) {
+    ArgparseResults *const results = &parser->results;
+    struct ArgparseCacheLayout layout;
+    Argparser_cache_layout(entry, &layout);
+    results->argc = argc;
+    results->argv = argv;
+
+    /* The subcommand adds its options, as in the original parse */
+    if (entry->subcommand) {
+        const ArgparseSubcommand *const subcommand =
+            parser->subcommands + entry->subcommand - 1;
+        if (Argparser_select_subcommand(parser, results, subcommand->name,
+                                        strlen(subcommand->name), -1))
             return 1;
-        } else {
-            begin = argv[*argv_index];
-            val_strlen = strlen(begin);
+    }
+    if (parser->num_opts != entry->num_opts)
+        return 1;
+
+    /* The states are in the order of the touched list, so a reset after a
+     * failure finds all that were restored */
+    results->touched = entry->touched;
+    const struct ArgparseCachedState *cached =
+        (const struct ArgparseCachedState *)entry->data;
+    const char *cached_items = entry->data + layout.items;
+    for (size_t i = 0; i < entry->num_states; ++i, ++cached) {
+        const ArgparseOpt *const opt = parser->opts + cached->opt_index;
+        ArgparseOptState *const state = results->states + cached->opt_index;
+        *state = cached->state;
+        state->begin = argv[state->argv_index] + cached->offset;
+        if (Argparser_is_list(opt->type)) {
+            const size_t size =
+                state->num_items * Argparser_item_size(opt->type);
+            char *items = NULL;
+            if (size) {
+                if (!(items = Argparser_alloc_items(results, size)))
+                    return 1;
+                memcpy(items, cached_items, size);
+            }
+            if (opt->type == ARG_STR_LIST)
+                for (size_t k = 0; k < state->num_items; ++k) {
+                    ArgparseSpan *const span = (ArgparseSpan *)items + k;
+                    span->begin = state->begin + (uintptr_t)span->begin;
+                }
+            state->items = items;
+            cached_items += size;
         }
+        if (opt->dest)
+            Argparser_store(opt, state);
+    }
+
+    while (results->occurrences_capacity < entry->num_occurrences) {
+        ArgparseOccurrence *new_occurrences;
+        if (!(new_occurrences = Argparser_grow(
+                  results->allocator, results->occurrences,
+                  &results->occurrences_capacity,
+                  sizeof *results->occurrences)))
+            return 1;
+        results->occurrences = new_occurrences;
+    }
+    const struct ArgparseCachedOccurrence *cached_occ =
+        (const struct ArgparseCachedOccurrence *)(entry->data +
+                                                  layout.occurrences);
+    for (size_t i = 0; i < entry->num_occurrences; ++i, ++cached_occ) {
+        ArgparseOccurrence *const occ = results->occurrences + i;
+        *occ = cached_occ->occ;
+        occ->begin = argv[occ->argv_index] + cached_occ->offset;
+    }
+    results->num_occurrences = entry->num_occurrences;
 
-        /* Handle different argument types */
-        if (Argparser_handle_opt(parser, opt, begin, val_strlen, 1))
+    /* Argparser_struct parsers always have room, as the parse did */
+    if (results->pos_args_capacity < entry->num_pos_args) {
+        int *new_pos_args;
+        if (!(new_pos_args = Argparser_realloc(
+                  results->allocator, results->pos_args,
+                  results->pos_args_capacity * sizeof *results->pos_args,
+                  entry->num_pos_args * sizeof *results->pos_args)))
             return 1;
+        results->pos_args = new_pos_args;
+        results->pos_args_capacity = entry->num_pos_args;
     }
-    opt->argv_index = *argv_index;
-    opt->begin = begin;
-    opt->val_strlen = val_strlen;
-    ++opt->count;
+    memcpy(results->pos_args, entry->data + layout.pos_args,
+           entry->num_pos_args * sizeof *results->pos_args);
+    results->num_pos_args = entry->num_pos_args;
     return 0;
 }
 
-int Argparser_parse(Argparser *const parser, const int argc,
-                    const char *const *const argv) {
-    int pos_args_only = 0;
-    for (int i = 1; i < argc; ++i) {
-        const size_t len = strlen(argv[i]);
-        if (!pos_args_only && len >= 3 && strncmp(argv[i], "--", 2) == 0) {
-            if (Argparser_recv_long_opt(parser, argc, argv, &i))
-                return 1;
-        } else if (!pos_args_only && len >= 2 && argv[i][0] == '-') {
-            if (argv[i][1] == '-')
-                pos_args_only = 1;
-            else if (Argparser_recv_short_opt(parser, argc, argv, &i, 1))
-                return 1;
-        } else if (Argparser_recv_pos_arg(parser, i))
-            return 1;
+static int Argparser_parse_cached(Argparser *const parser, const int argc,
+                                  const char *const *const argv) {
+    ArgparseResults *const results = &parser->results;
+    /* Only results parsed from scratch depend on the command line alone.
+     * Every call counts as a parse and as a hit or a miss. */
+    uint64_t hash;
+    if (argc < 1 || results->touched || results->num_pos_args ||
+        results->num_occurrences || results->subcommand ||
+        Argparser_hash_argv(argc, argv, &hash)) {
+        ARGPARSER_COUNT(&results->stats, cache_misses, 1);
+        return Argparser_parse_results(parser, results, argc, argv);
     }
+
+    ARGPARSER_TIMER(start);
+    const uint32_t i = Argparser_cache_find(parser, hash, argc, argv);
+    if (i) {
+        if (!Argparser_cache_restore(parser, parser->cache->entries + i - 1,
+                                     argc, argv)) {
+            ARGPARSER_COUNT(&results->stats, parses, 1);
+            ARGPARSER_COUNT(&results->stats, cache_hits, 1);
+            ARGPARSER_ELAPSED(&results->stats, parse_ticks, start);
+            return 0;
+        }
+        Argparser_reset(parser);
+    }
+
+    ARGPARSER_COUNT(&results->stats, cache_misses, 1);
+    if (Argparser_parse_results(parser, results, argc, argv))
+        return 1;
+    /* Response files may change, so their tokens are not part of the key */
+    if (!results->num_tokens)
+        Argparser_cache_insert(parser, hash, argc, argv);
     return 0;
 }
 
-#define ASSIGN_INFO(_opt, _begin, _len, _argv_index)                           \
+#define ASSIGN_INFO(_state, _begin, _len, _argv_index)                         \
     do {                                                                       \
         if (_begin)                                                            \
-            *_begin = _opt->begin;                                             \
+            *_begin = _state->begin;                                           \
         if (_len)                                                              \
-            *_len = _opt->val_strlen;                                          \
+            *_len = _state->val_strlen;                                        \
         if (_argv_index)                                                       \
-            *_argv_index = _opt->argv_index;                                   \
+            *_argv_index = _state->argv_index;                                 \
     } while (0)
 
+/* Get the results for opt, first converting a value left for later by
+ * ARGPARSER_LAZY_CONVERSION. The outcome is cached in the results, and the
+ * conversion counted in their stats. */
+static ArgparseOptState *
+Argparser_converted_opt_state(const Argparser *const parser,
+                              const ArgparseOpt *const opt) {
+    ArgparseOptState *const state = Argparser_opt_state(parser, opt);
+    if (state && state->conversion == ARG_CONVERSION_PENDING) {
+        ArgparseStats *const stats = (ArgparseStats *)&parser->results.stats;
+        ARGPARSER_TIMER(start);
+        ARGPARSER_COUNT(stats, conversions, 1);
+        state->conversion = Argparser_convert_value(
+            parser, opt, state, state->begin, state->val_strlen);
+        ARGPARSER_ELAPSED(stats, convert_ticks, start);
+    }
+    return state;
+}
+
+static ArgparseOptState *
+Argparser_converted_state(const Argparser *const parser, const char short_opt,
+                          const char *const long_opt) {
+    return Argparser_converted_opt_state(
+        parser, Argparser_get_opt_ptr(parser, short_opt, long_opt));
+}
+
+int Argparser_conversion(const Argparser *const parser, const char short_opt,
+                         const char *const long_opt) {
+    const ArgparseOptState *state;
+    if (!(state = Argparser_converted_state(parser, short_opt, long_opt)))
+        return -1;
+    return state->count ? (int)state->conversion : ARG_CONVERSION_ABSENT;
+}
+
+int Argparser_convert_index(const Argparser *const parser,
+                            const size_t index) {
+    if (index >= parser->num_opts)
+        return -1;
+    const ArgparseOptState *const state =
+        Argparser_converted_opt_state(parser, parser->opts + index);
+    return state->count ? (int)state->conversion : ARG_CONVERSION_ABSENT;
+}
+
 intmax_t Argparser_int_result(const Argparser *const parser,
                               const char short_opt, const char *const long_opt,
                               int *const count, const char **const begin,
                               size_t *const len, int *const argv_index) {
-    ArgparseOpt *opt;
-    if (!(opt = Argparser_get_opt_ptr(parser, short_opt, long_opt))) {
-        *count = -1;
+    const ArgparseOptState *state;
+    if (!(state = Argparser_converted_state(parser, short_opt, long_opt))) {
+        if (count)
+            *count = -1;
+        return 0;
+    }
+    ASSIGN_INFO(state, begin, len, argv_index);
+    if (count)
+        *count = state->count;
+    return state->conversion == ARG_CONVERSION_OK ? state->int_val : 0;
+}
+
+uintmax_t Argparser_uint_result(const Argparser *const parser,
+                                const char short_opt,
+                                const char *const long_opt, int *const count,
+                                const char **const begin, size_t *const len,
+                                int *const argv_index) {
+    const ArgparseOptState *state;
+    if (!(state = Argparser_converted_state(parser, short_opt, long_opt))) {
+        if (count)
+            *count = -1;
         return 0;
     }
-    ASSIGN_INFO(opt, begin, len, argv_index);
+    ASSIGN_INFO(state, begin, len, argv_index);
     if (count)
-        *count = opt->count;
-    return opt->int_val;
+        *count = state->count;
+    return state->conversion == ARG_CONVERSION_OK ? state->uint_val : 0;
 }
 
 double Argparser_float_result(const Argparser *const parser,
                               const char short_opt, const char *const long_opt,
                               int *const count, const char **const begin,
                               size_t *const len, int *const argv_index) {
-    ArgparseOpt *opt;
-    if (!(opt = Argparser_get_opt_ptr(parser, short_opt, long_opt))) {
-        *count = -1;
+    const ArgparseOptState *state;
+    if (!(state = Argparser_converted_state(parser, short_opt, long_opt))) {
+        if (count)
+            *count = -1;
         return 0;
     }
-    ASSIGN_INFO(opt, begin, len, argv_index);
+    ASSIGN_INFO(state, begin, len, argv_index);
     if (count)
-        *count = opt->count;
-    return opt->float_val;
+        *count = state->count;
+    return state->conversion == ARG_CONVERSION_OK ? state->float_val : 0;
 }
 
 int Argparser_str_result(const Argparser *const parser, const char short_opt,
                          const char *const long_opt, const char **const begin,
                          size_t *const len, int *const argv_index) {
-    ArgparseOpt *opt;
-    if (!(opt = Argparser_get_opt_ptr(parser, short_opt, long_opt)))
+    const ArgparseOptState *state;
+    if (!(state = Argparser_opt_state(
+              parser, Argparser_get_opt_ptr(parser, short_opt, long_opt))))
         return -1;
-    if (opt->count == 0)
+    if (state->count == 0)
         return 0;
 
-    ASSIGN_INFO(opt, begin, len, argv_index);
-    return opt->count;
+    ASSIGN_INFO(state, begin, len, argv_index);
+    return state->count;
 }
 
 int Argparser_bool_result(const Argparser *const parser, const char short_opt,
                           const char *const long_opt, const char **const begin,
                           int *const argv_index) {
-    ArgparseOpt *opt;
-    if (!(opt = Argparser_get_opt_ptr(parser, short_opt, long_opt)))
+    const ArgparseOptState *state;
+    if (!(state = Argparser_opt_state(
+              parser, Argparser_get_opt_ptr(parser, short_opt, long_opt))))
         return -1;
     if (begin)
-        *begin = opt->begin;
+        *begin = state->begin;
     if (argv_index)
-        *argv_index = opt->argv_index;
-    return opt->count;
+        *argv_index = state->argv_index;
+    return state->count;
+}
+
+/* Get the results for a list option of the given type, otherwise NULL */
+static const ArgparseOptState *
+Argparser_list_state(const Argparser *const parser, const char short_opt,
+                     const char *const long_opt, const ArgparseType type,
+                     size_t *const num_items) {
+    const ArgparseOpt *const opt =
+        Argparser_get_opt_ptr(parser, short_opt, long_opt);
+    const ArgparseOptState *const state = Argparser_opt_state(parser, opt);
+    const int found = state && opt->type == type && state->count;
+    if (num_items)
+        *num_items = found ? state->num_items : 0;
+    return found ? state : NULL;
+}
+
+const intmax_t *Argparser_int_list_result(const Argparser *const parser,
+                                          const char short_opt,
+                                          const char *const long_opt,
+                                          size_t *const num_items) {
+    const ArgparseOptState *const state = Argparser_list_state(
+        parser, short_opt, long_opt, ARG_INT_LIST, num_items);
+    return state ? Argparser_list_items(state) : NULL;
+}
+
+const double *Argparser_float_list_result(const Argparser *const parser,
+                                          const char short_opt,
+                                          const char *const long_opt,
+                                          size_t *const num_items) {
+    const ArgparseOptState *const state = Argparser_list_state(
+        parser, short_opt, long_opt, ARG_FLOAT_LIST, num_items);
+    return state ? Argparser_list_items(state) : NULL;
+}
+
+const ArgparseSpan *Argparser_str_list_result(const Argparser *const parser,
+                                              const char short_opt,
+                                              const char *const long_opt,
+                                              size_t *const num_items) {
+    const ArgparseOptState *const state = Argparser_list_state(
+        parser, short_opt, long_opt, ARG_STR_LIST, num_items);
+    return state ? Argparser_list_items(state) : NULL;
+}
+
+const ArgparseOccurrence *
+Argparser_first_occurrence(const Argparser *const parser, const char short_opt,
+                           const char *const long_opt) {
+    const ArgparseOptState *state;
+    if (!(state = Argparser_opt_state(
+              parser, Argparser_get_opt_ptr(parser, short_opt, long_opt))) ||
+        !state->first_occurrence)
+        return NULL;
+    return parser->results.occurrences + state->first_occurrence - 1;
+}
+
+const ArgparseOccurrence *
+Argparser_next_occurrence(const Argparser *const parser,
+                          const ArgparseOccurrence *const occ) {
+    return occ->next ? parser->results.occurrences + occ->next - 1 : NULL;
+}
+
+const ArgparseSubcommand *Argparser_subcommand(const Argparser *const parser) {
+    return parser->results.subcommand
+               ? parser->subcommands + parser->results.subcommand - 1
+               : NULL;
 }
 
 size_t Argparser_num_pos_args(const Argparser *const parser) {
-    return parser->num_pos_args;
+    return parser->results.num_pos_args;
+}
+
+const char *Argparser_arg(const Argparser *const parser,
+                          const int argv_index) {
+    return Argparser_results_arg(&parser->results, argv_index);
 }
 
 int Argparser_get_pos_arg(const Argparser *const parser, const size_t pos,
                           int *const argv_index) {
-    if (parser->num_pos_args <= pos)
+    if (parser->results.num_pos_args <= pos)
         return 1;
     if (argv_index)
-        *argv_index = parser->pos_args[pos];
+        *argv_index = parser->results.pos_args[pos];
     return 0;
 }
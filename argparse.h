@@ -21,61 +21,622 @@ extern "C" {
 #define ARGPARSER_INITIAL_CAPACITY 10
 #endif
 
+/* Limit on response files including other response files */
+#ifndef ARGPARSER_MAX_RESPONSE_DEPTH
+#define ARGPARSER_MAX_RESPONSE_DEPTH 16
+#endif
+
+/* Minimum size of the blocks holding tokens split by Argparser_feed_buffer */
+#ifndef ARGPARSER_BLOCK_SIZE
+#define ARGPARSER_BLOCK_SIZE 4096
+#endif
+
+/* Longest command line, in bytes after argv[0], that Argparser_set_cache
+ * caches. Longer ones take longer to compare than to parse. */
+#ifndef ARGPARSER_CACHE_MAX_BYTES
+#define ARGPARSER_CACHE_MAX_BYTES 65536
+#endif
+
+/* Parsers with at least this many options get a hashed lookup index when
+ * first parsing; Argparser_freeze builds one regardless */
+#ifndef ARGPARSER_INDEX_THRESHOLD
+#define ARGPARSER_INDEX_THRESHOLD 16
+#endif
+
+/* Signed integers are queried with Argparser_int_result, unsigned ones with
+ * Argparser_uint_result. Values outside of the type's range are errors, and
+ * so are floats too large for a double, unless spelled as infinity. Floats
+ * too small for one are rounded to a subnormal number or zero. Unsigned
+ * values may have a '+' sign. List types split their value at a delimiter,
+ * see ARG_FLAG_DELIMITER and Argparser_int_list_result. */
 typedef enum ArgparseType {
     ARG_INT,
     ARG_FLOAT,
     ARG_STR,
-    ARG_BOOL
+    ARG_BOOL,
+    ARG_INT8,
+    ARG_INT16,
+    ARG_INT32,
+    ARG_INT64,
+    ARG_UINT,
+    ARG_UINT8,
+    ARG_UINT16,
+    ARG_UINT32,
+    ARG_UINT64,
+    ARG_INT_LIST,
+    ARG_FLOAT_LIST,
+    ARG_STR_LIST
 } ArgparseType;
 
+typedef enum ArgparseFlag {
+    /* Keep every occurrence, see Argparser_first_occurrence */
+    ARG_FLAG_ACCUMULATE = 1 << 0,
+    /* Integers may be hexadecimal with a "0x" prefix */
+    ARG_FLAG_HEX = 1 << 1,
+    /* Integers may have a k, m, g, t or p suffix for 2^10, 2^20 etc. */
+    ARG_FLAG_SIZE_SUFFIX = 1 << 2,
+    /* long_opt is not copied by Argparser_add_argument_flags and must outlive
+     * the parser. Set for every option with ARGPARSER_BORROW_NAMES. */
+    ARG_FLAG_BORROWED = 1 << 3
+} ArgparseFlag;
+
+/* Flag setting the delimiter of a list option, ',' if not given */
+#define ARG_FLAG_DELIMITER(c) ((unsigned)(unsigned char)(c) << 24)
+
+/* Outcome of converting the value of a numeric option */
+typedef enum ArgparseConversion {
+    ARG_CONVERSION_OK,
+    /* Not converted yet, see ARGPARSER_LAZY_CONVERSION */
+    ARG_CONVERSION_PENDING,
+    ARG_CONVERSION_INVALID,
+    ARG_CONVERSION_OUT_OF_RANGE,
+    /* A float over 127 chars could not be copied to convert it */
+    ARG_CONVERSION_NO_MEMORY,
+    /* The option was not given. Only returned by Argparser_conversion, never
+     * stored in the results. */
+    ARG_CONVERSION_ABSENT
+} ArgparseConversion;
+
+/* Results for one option */
+typedef struct ArgparseOptState {
+    const char *begin;
+    size_t val_strlen;
+    int count, argv_index;
+    ArgparseConversion conversion;
+    union {
+        intmax_t int_val;
+        uintmax_t uint_val;
+        double float_val;
+        /* Items of a list option */
+        const void *items;
+    };
+    size_t num_items;
+    /* Occurrences of an ARG_FLAG_ACCUMULATE option, plus one, 0 if none */
+    size_t first_occurrence, last_occurrence;
+    /* Next option that occurred since the last reset, plus one, 0 if none */
+    size_t next_touched;
+} ArgparseOptState;
+
+/* Destination of an ARG_STR option, see ArgparseOpt.dest, and item of an
+ * ARG_STR_LIST option */
+typedef struct ArgparseSpan {
+    const char *begin;
+    size_t len;
+} ArgparseSpan;
+
+/* Destination of a list option. items is not NULL once written, even for an
+ * empty list. */
+typedef struct ArgparseList {
+    const void *items;
+    size_t num_items;
+} ArgparseList;
+
 typedef struct ArgparseOpt {
     char short_opt;
     char *long_opt;
     ArgparseType type;
+    unsigned flags;
+    /*
+     * If not NULL, written whenever the option is recorded into the parser's
+     * own results, so no query is needed: an int set to the count for
+     * ARG_BOOL, an ArgparseSpan for ARG_STR, a double for ARG_FLOAT, an
+     * intmax_t or uintmax_t for ARG_INT or ARG_UINT, an ArgparseList for
+     * list types, and the sized integer type otherwise. Values are converted
+     * while parsing even with ARGPARSER_LAZY_CONVERSION. Resets leave
+     * destinations alone.
+     */
+    void *dest;
+} ArgparseOpt;
+
+/* One occurrence of an ARG_FLAG_ACCUMULATE option */
+typedef struct ArgparseOccurrence {
     const char *begin;
     size_t val_strlen;
-    int count, argv_index;
+    int argv_index;
+    /* Next occurrence of the same option, plus one, 0 if last */
+    size_t next;
     union {
         intmax_t int_val;
+        uintmax_t uint_val;
         double float_val;
     };
-} ArgparseOpt;
+} ArgparseOccurrence;
+
+typedef enum ArgparserFlag {
+    /*
+     * Expand "@path" tokens (except after "--") to the whitespace-separated,
+     * shell-style quoted tokens in the file at path, recursively. The file is
+     * mapped until the results are reset and results point into the mapping.
+     * Its tokens get the argv indices argc, argc + 1, ... in order of
+     * expansion, see Argparser_arg.
+     */
+    ARGPARSER_RESPONSE_FILES = 1 << 0,
+    /* Argparser_add_argument stores long_opt pointers without copying them,
+     * see ARG_FLAG_BORROWED */
+    ARGPARSER_BORROW_NAMES = 1 << 1,
+    /*
+     * Only record the values of numeric options while parsing, and convert
+     * the last value of an option on the first query. Bad values are then
+     * not parse errors: the Argparser_*_result functions return 0 for them,
+     * and Argparser_conversion tells why. List options, ARG_FLAG_ACCUMULATE
+     * options and options with a destination are still converted while
+     * parsing.
+     *
+     * Queries are then not thread-safe: the first query of a value writes
+     * the outcome into the results through the const parser, so queries of
+     * the same results must not run concurrently, with each other or with
+     * Argparser_snapshot.
+     */
+    ARGPARSER_LAZY_CONVERSION = 1 << 2,
+    /* Accept unambiguous prefixes of long options, like getopt_long. An
+     * exact name always wins. */
+    ARGPARSER_ABBREVIATIONS = 1 << 3,
+    /* Also print parse errors to stderr as they happen, see ArgparseError */
+    ARGPARSER_PRINT_ERRORS = 1 << 4
+} ArgparserFlag;
+
+/* Why a parse failed */
+typedef enum ArgparseErrorCode {
+    ARG_ERROR_NONE,
+    ARG_ERROR_UNKNOWN_OPTION,
+    ARG_ERROR_AMBIGUOUS_OPTION,
+    /* An ARG_BOOL option given a value with '=' */
+    ARG_ERROR_UNEXPECTED_VALUE,
+    ARG_ERROR_MISSING_VALUE,
+    ARG_ERROR_INVALID_VALUE,
+    ARG_ERROR_OUT_OF_RANGE,
+    ARG_ERROR_TOO_MANY_POS_ARGS,
+    /* More tokens than an int can index */
+    ARG_ERROR_TOO_MANY_ARGS,
+    ARG_ERROR_UNKNOWN_COMMAND,
+    /* The init function of a subcommand failed */
+    ARG_ERROR_COMMAND_SETUP,
+    /* Subcommands were used with results other than the parser's own */
+    ARG_ERROR_NOT_OWN_RESULTS,
+    /* A response file could not be opened or mapped, see sys_errno */
+    ARG_ERROR_RESPONSE_FILE,
+    ARG_ERROR_NOT_REGULAR_FILE,
+    ARG_ERROR_NESTED_TOO_DEEPLY,
+    ARG_ERROR_UNTERMINATED_QUOTE,
+    ARG_ERROR_ALLOCATION,
+    ARG_ERROR_INTERNAL
+} ArgparseErrorCode;
+
+/*
+ * Why the last parse failed. Parsing only records it: nothing is formatted
+ * or printed unless Argparser_format_error is called or
+ * ARGPARSER_PRINT_ERRORS is set. Pointers stay valid until the next reset.
+ */
+typedef struct ArgparseError {
+    ArgparseErrorCode code;
+    /* Token the error is in, -1 if none, see Argparser_arg */
+    int argv_index;
+    /* Offending part of the token: the option name or value, the whole
+     * token, or a response file path. Not '\0'-terminated. */
+    const char *begin;
+    size_t len;
+    /* Option involved, or NULL */
+    const ArgparseOpt *opt;
+    /* Nonzero if the option was given in long form */
+    int is_long;
+    /* errno for ARG_ERROR_RESPONSE_FILE */
+    int sys_errno;
+} ArgparseError;
+
+/*
+ * What parsing did, see Argparser_stats. The counters are only kept when
+ * argparse.c is compiled with ARGPARSER_STATS defined, and stay zero
+ * otherwise; the struct is the same either way. ARGPARSER_STATS_TIMERS also
+ * times the phases of parsing in ticks, which are TSC cycles on x86 and
+ * nanoseconds elsewhere.
+ */
+typedef struct ArgparseStats {
+    /* Command lines parsed and tokens received, including response file and
+     * fed tokens, and bytes the tokenizers went through */
+    uint64_t parses, tokens, bytes_scanned;
+    /* Option names looked up while parsing, and names or slots compared.
+     * Lookups by the Argparser_*_result functions are not counted, so that
+     * queries leave a shared parser alone. */
+    uint64_t lookups, lookup_compares;
+    /* Numeric values converted, including list items and values left for
+     * the first query by ARGPARSER_LAZY_CONVERSION */
+    uint64_t conversions;
+    /* Response files read, and errors recorded */
+    uint64_t response_files, errors;
+    /* Argparser_parse calls answered from the cache and those that missed,
+     * see Argparser_set_cache */
+    uint64_t cache_hits, cache_misses;
+    /* Growth of the pos_args and opts arrays */
+    uint64_t pos_args_reallocs, opts_reallocs;
+    /* Whole Argparser_parse* calls, and the time spent scanning tokens,
+     * looking up options, converting values and reading response files */
+    uint64_t parse_ticks, scan_ticks, lookup_ticks, convert_ticks, file_ticks;
+} ArgparseStats;
+
+/*
+ * Memory for a parser and its results. reallocate works like realloc(3),
+ * allocating if ptr is NULL; old_size is the size of the block at ptr.
+ * release may be NULL when the owner frees all memory at once.
+ *
+ * Calls that may allocate:
+ * - Argparser_init*: the opts, states and pos_args arrays.
+ * - Argparser_add_argument*: larger opts and states arrays, and the copy of
+ *   long_opt unless it is borrowed.
+ * - Argparser_add_subcommand: a larger subcommands array.
+ * - Argparser_freeze: the lookup index, which with a lookup hook only serves
+ *   prefix queries.
+ * - The first Argparser_parse, Argparser_feed*, Argparser_freeze or
+ *   Argparser_load_snapshot of a parser set up with Argparser_struct or
+ *   Argparser_struct_lookup: the states array.
+ * - The first Argparser_parse, Argparser_feed or Argparser_feed_buffer after
+ *   options were added: the lookup index, if there are at least
+ *   ARGPARSER_INDEX_THRESHOLD options and no lookup hook, or a lookup hook
+ *   and ARGPARSER_ABBREVIATIONS.
+ * - Parsing: a larger pos_args array (never for Argparser_struct parsers),
+ *   occurrences of ARG_FLAG_ACCUMULATE options, tokens of response files and
+ *   of Argparser_feed*, blocks for tokens split by Argparser_feed_buffer,
+ *   floats over 127 chars that are not '\0'-terminated, and blocks for the
+ *   items of list options. Response files are mapped with mmap, not
+ *   allocated. The first float that needs strtod_l makes libc allocate a C
+ *   locale, once per process.
+ * - Selecting a subcommand other than the last one: the hash table over
+ *   subcommand names, once, and whatever its options need.
+ * - Argparser_results_init: the states and pos_args arrays.
+ * - Argparser_load_snapshot: what parsing the same command line would,
+ *   except for response files and split tokens.
+ * - Argparser_set_cache: the cache, and Argparser_parse with a cache: a copy
+ *   of each new command line and its results, and what restoring them needs
+ *   (a larger pos_args array, occurrences and list items).
+ * - Argparser_parse_batch: the thread handles.
+ * - With ARGPARSER_PRINT_ERRORS: error messages over 255 chars, while they
+ *   are printed.
+ * Nothing else allocates; resets keep memory for reuse where they can. A
+ * frozen Argparser_struct_states parser without response files,
+ * Argparser_feed* or ARG_FLAG_ACCUMULATE options never allocates.
+ */
+typedef struct ArgparseAllocator {
+    void *(*reallocate)(void *ctx, void *ptr, size_t old_size,
+                        size_t new_size);
+    void (*release)(void *ctx, void *ptr);
+    void *ctx;
+} ArgparseAllocator;
+
+struct ArgparseIndex;
+struct ArgparseMapping;
+struct ArgparseBlock;
+struct Argparser;
+
+/* Replaces the built-in lookup, see argparse-gen. Looks up short_opt if it is
+ * not '\0', otherwise the first len chars of long_opt. */
+typedef ArgparseOpt *(*ArgparseLookup)(const struct Argparser *parser,
+                                       const char short_opt,
+                                       const char *const long_opt,
+                                       const size_t len);
+
+/* Adds the options of a subcommand, see Argparser_add_subcommand. Returns
+ * nonzero on failure. */
+typedef int (*ArgparseSubcommandInit)(struct Argparser *parser, void *data);
+
+typedef struct ArgparseSubcommand {
+    const char *name;
+    ArgparseSubcommandInit init;
+    void *data;
+} ArgparseSubcommand;
+
+/* Everything a parse produces, see Argparser_results_init */
+typedef struct ArgparseResults {
+    /* Indexed like Argparser.opts, apart from them so that the options stay
+     * compact for lookups */
+    ArgparseOptState *states;
+    size_t num_pos_args, pos_args_capacity;
+    int *pos_args;
+    /* Shared by all ARG_FLAG_ACCUMULATE options, in argv order */
+    ArgparseOccurrence *occurrences;
+    size_t num_occurrences, occurrences_capacity;
+    /* Arguments of the last parse */
+    int argc;
+    const char *const *argv;
+    /* Response file and fed tokens, and storage backing them */
+    const char **tokens;
+    size_t num_tokens, tokens_capacity;
+    struct ArgparseMapping *mappings;
+    size_t num_mappings, mappings_capacity;
+    struct ArgparseBlock *blocks;
+    size_t partial_len;
+    /* Items of list options, which never move until reset */
+    struct ArgparseBlock *list_blocks;
+    /* First option that occurred since the last reset, plus one, 0 if none */
+    size_t touched;
+    /* Option still waiting for its value, and the token naming it */
+    const ArgparseOpt *pending_opt;
+    int pending_is_long, pending_argv_index, pos_args_only;
+    /* Selected subcommand, plus one, 0 if none */
+    size_t subcommand;
+    /* NULL for malloc and friends */
+    const ArgparseAllocator *allocator;
+    ArgparseError error;
+    /* Kept across resets, see Argparser_reset_stats */
+    ArgparseStats stats;
+} ArgparseResults;
 
 typedef struct Argparser {
     const char *prog_name;
-    size_t num_opts, opts_capacity, num_pos_args, pos_args_capacity;
+    size_t num_opts, opts_capacity;
     intmax_t max_pos_args;
-    int *pos_args;
     ArgparseOpt *opts;
+    /* Built by Argparser_freeze or lazily by Argparser_parse, released by
+     * Argparser_deinit */
+    struct ArgparseIndex *index;
+    /* Nonzero if opts and pos_args were allocated by Argparser_init */
+    int owned;
+    /* Nonzero if the states of an Argparser_struct parser were allocated on
+     * first use */
+    int owns_states;
+    ArgparseLookup lookup;
+    /* Flags from ArgparserFlag */
+    unsigned flags;
+    /* NULL for malloc and friends */
+    const ArgparseAllocator *allocator;
+    ArgparseSubcommand *subcommands;
+    size_t num_subcommands, subcommands_capacity;
+    /* Hash table over subcommands, holding indices plus one */
+    uint32_t *subcommand_slots;
+    size_t subcommand_mask;
+    /* Options before those of the selected subcommand were added, and the
+     * lookup index over them, kept aside until the next reset */
+    size_t num_global_opts;
+    struct ArgparseIndex *global_index;
+    /* Subcommand that added the options after the global ones, plus one, 0
+     * if none. Between a reset and selecting it again, its options are kept
+     * after num_opts, up to num_loaded_opts, with the index over all
+     * options. */
+    size_t loaded_subcommand, num_loaded_opts;
+    struct ArgparseIndex *loaded_index;
+    /* Set by Argparser_set_cache, released by Argparser_deinit */
+    struct ArgparseCache *cache;
+    ArgparseResults results;
 } Argparser;
 
+/* Set up a parser over caller-provided arrays: num_opts options and room for
+ * max_pos_args positional arguments. The states are allocated on the first
+ * parse, feed, freeze or snapshot load, and released by Argparser_deinit. */
 #define Argparser_struct(prog_name, num_opts, opts, max_pos_args, pos_args)    \
+    Argparser_struct_lookup(prog_name, num_opts, opts, max_pos_args, pos_args, \
+                            NULL)
+
+#define Argparser_struct_lookup(prog_name, num_opts, opts, max_pos_args,       \
+                                pos_args, lookup)                              \
+    Argparser_struct_states_lookup(prog_name, num_opts, opts, NULL,            \
+                                   max_pos_args, pos_args, lookup)
+
+/* Like Argparser_struct, with num_opts zeroed states provided by the caller,
+ * so that the parser never allocates them */
+#define Argparser_struct_states(prog_name, num_opts, opts, states,             \
+                                max_pos_args, pos_args)                        \
+    Argparser_struct_states_lookup(prog_name, num_opts, opts, states,          \
+                                   max_pos_args, pos_args, NULL)
+
+#define Argparser_struct_states_lookup(prog_name, num_opts, opts, states,      \
+                                       max_pos_args, pos_args, lookup)         \
     {                                                                          \
-        prog_name, num_opts, num_opts, 0, max_pos_args, max_pos_args,          \
-            pos_args, opts                                                     \
+        prog_name, num_opts, num_opts, max_pos_args, opts, NULL, 0, 0, lookup, \
+            0, NULL, NULL, 0, 0, NULL, 0, 0, NULL, 0, 0, NULL, NULL,           \
+        {                                                                      \
+            states, 0, max_pos_args, pos_args, NULL, 0, 0, 0, NULL, NULL, 0, 0,\
+                NULL, 0, 0, NULL, 0, NULL, 0, NULL, 0, 0, 0, 0, NULL,          \
+                {ARG_ERROR_NONE, 0, NULL, 0, NULL, 0, 0},                      \
+                {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}            \
+        }                                                                      \
     }
 
 int Argparser_init(Argparser *const parser, const char *const prog_name,
                    const intmax_t max_pos_args);
 
+/* Like Argparser_init, with memory from allocator, which must outlive the
+ * parser and any results initialized from it */
+int Argparser_init_allocator(Argparser *const parser,
+                             const char *const prog_name,
+                             const intmax_t max_pos_args,
+                             const ArgparseAllocator *const allocator);
+
+/* Like Argparser_init, with all memory carved from the size bytes at buf,
+ * which must outlive the parser. Allocations fail once buf is full. Results
+ * initialized from the parser also allocate from buf, from any thread, and
+ * must be deinitialized before the parser. */
+int Argparser_init_buffer(Argparser *const parser, const char *const prog_name,
+                          const intmax_t max_pos_args, void *const buf,
+                          const size_t size);
+
+/* Use allocator for a parser set up with Argparser_struct, before it is
+ * frozen or parses anything */
+void Argparser_set_allocator(Argparser *const parser,
+                             const ArgparseAllocator *const allocator);
+
+/* Also safe on parsers set up with Argparser_struct; only the lookup index
+ * and states allocated on first use are released in that case */
 void Argparser_deinit(Argparser *const parser);
 
 int Argparser_add_argument(Argparser *const parser, const char short_opt,
                            const char *const long_opt, const ArgparseType type);
 
+/* Like Argparser_add_argument, with flags from ArgparseFlag */
+int Argparser_add_argument_flags(Argparser *const parser, const char short_opt,
+                                 const char *const long_opt,
+                                 const ArgparseType type,
+                                 const unsigned flags);
+
+/* Like Argparser_add_argument_flags, writing the option's value to dest, see
+ * ArgparseOpt.dest */
+int Argparser_add_argument_dest(Argparser *const parser, const char short_opt,
+                                const char *const long_opt,
+                                const ArgparseType type, const unsigned flags,
+                                void *const dest);
+
+/*
+ * Register a subcommand, selected by the first positional argument, which is
+ * not counted as one. Only when it is selected does init add its options,
+ * with the options added so far shared as global options. Argparser_reset
+ * puts them aside, and selecting the same subcommand again brings them back
+ * without calling init; selecting another one, adding a global option or
+ * Argparser_deinit removes them. name must outlive the parser. Subcommands
+ * need a parser from Argparser_init* that parses into its own results.
+ */
+int Argparser_add_subcommand(Argparser *const parser, const char *const name,
+                             const ArgparseSubcommandInit init,
+                             void *const data);
+
 int Argparser_parse(Argparser *const parser, const int argc,
                     const char *const *const argv);
 
+/*
+ * Incremental parsing: Argparser_feed processes one token,
+ * Argparser_feed_buffer a chunk of '\0'-terminated tokens whose last token
+ * may continue in the next chunk, and Argparser_finish ends the command line.
+ * Unlike with Argparser_parse, the first token is not skipped. Tokens get
+ * argv indices 0, 1, ... and must stay valid until Argparser_reset, like
+ * argv.
+ */
+int Argparser_feed(Argparser *const parser, const char *const token);
+
+int Argparser_feed_buffer(Argparser *const parser, const char *buf,
+                          const size_t len);
+
+int Argparser_finish(Argparser *const parser);
+
+/* Forget all results, so that the parser can be reused for another command
+ * line. Takes time proportional to the number of options that occurred.
+ * Options added by the selected subcommand are put aside until it is selected
+ * again, see Argparser_add_subcommand, and the lookup index over the others
+ * is kept. */
+void Argparser_reset(Argparser *const parser);
+
+/* Build the lookup index now rather than on the first Argparser_parse, even
+ * below ARGPARSER_INDEX_THRESHOLD options. Must be called before a parser is
+ * shared between threads. */
+int Argparser_freeze(Argparser *const parser);
+
+/*
+ * Separate results, so that threads can parse concurrently with one shared,
+ * frozen parser that no longer gets new options. Argparser_results_view
+ * makes a read-only Argparser for the Argparser_*_result functions, valid
+ * until the results change.
+ */
+int Argparser_results_init(const Argparser *const parser,
+                           ArgparseResults *const results);
+
+void Argparser_results_deinit(ArgparseResults *const results);
+
+void Argparser_results_reset(const Argparser *const parser,
+                             ArgparseResults *const results);
+
+int Argparser_parse_results(const Argparser *const parser,
+                            ArgparseResults *const results, const int argc,
+                            const char *const *const argv);
+
+void Argparser_results_view(const Argparser *const parser,
+                            const ArgparseResults *const results,
+                            Argparser *const view);
+
+/*
+ * Snapshots of the parser's results, for processes that need the same
+ * results without parsing. A snapshot is one position-independent blob with
+ * the options that occurred, their converted values and list items, the
+ * positional arguments and copies of all tokens. Argparser_snapshot writes it
+ * to buf, failing if size is below Argparser_snapshot_size.
+ *
+ * Argparser_load_snapshot resets the parser and makes the snapshot at blob
+ * its results, which then point into blob. The parser must have the options
+ * and subcommands of the one that wrote the snapshot, and blob must stay
+ * valid until the next reset. Snapshots are for the same build on the same
+ * machine, as they are in native byte order.
+ */
+size_t Argparser_snapshot_size(const Argparser *const parser);
+
+int Argparser_snapshot(const Argparser *const parser, void *const buf,
+                       const size_t size);
+
+int Argparser_load_snapshot(Argparser *const parser, const void *const blob,
+                            const size_t size);
+
+/*
+ * Memoize Argparser_parse for up to max_entries distinct command lines,
+ * evicting the least recently used; 0 turns the cache off. A command line
+ * that parsed before, with the same flags, gets a copy of its results,
+ * list items included, with spans pointing into the new argv instead of
+ * being parsed again. Only parses that start from reset results are cached,
+ * and not those that fail, read response files or exceed
+ * ARGPARSER_CACHE_MAX_BYTES. argv[0] is not part of the key.
+ *
+ * Adding options or subcommands clears the cache, except for options that
+ * subcommands add when selected, which must be the same every time.
+ * Argparser_clear_cache does so explicitly, for other changes to the parser.
+ */
+int Argparser_set_cache(Argparser *const parser, const size_t max_entries);
+
+void Argparser_clear_cache(Argparser *const parser);
+
+/* One command line for Argparser_parse_batch */
+typedef struct ArgparseJob {
+    int argc;
+    const char *const *argv;
+    /* Initialized by Argparser_results_init, reset before parsing */
+    ArgparseResults *results;
+    /* Return value of the parse */
+    int status;
+} ArgparseJob;
+
+/* Parse the jobs on num_threads threads (0 for one per online CPU). Returns
+ * nonzero if threads could not be started or any job failed. */
+int Argparser_parse_batch(const Argparser *const parser,
+                          ArgparseJob *const jobs, const size_t num_jobs,
+                          unsigned num_threads);
+
 intmax_t Argparser_int_result(const Argparser *const parser,
                               const char short_opt, const char *const long_opt,
                               int *const count, const char **const begin,
                               size_t *const len, int *const argv_index);
 
+uintmax_t Argparser_uint_result(const Argparser *const parser,
+                                const char short_opt,
+                                const char *const long_opt, int *const count,
+                                const char **const begin, size_t *const len,
+                                int *const argv_index);
+
 double Argparser_float_result(const Argparser *const parser,
                               const char short_opt, const char *const long_opt,
                               int *const count, const char **const begin,
                               size_t *const len, int *const argv_index);
 
+/* ArgparseConversion for the last value of a numeric option, after converting
+ * it if needed, ARG_CONVERSION_ABSENT if the option was not given, or -1 if
+ * there is no such option. Not thread-safe with ARGPARSER_LAZY_CONVERSION. */
+int Argparser_conversion(const Argparser *const parser, const char short_opt,
+                         const char *const long_opt);
+
+/* Argparser_conversion for the option at index in parser->opts, without
+ * looking its name up, or -1 if there is no such option */
+int Argparser_convert_index(const Argparser *const parser, const size_t index);
+
 int Argparser_str_result(const Argparser *const parser, const char short_opt,
                          const char *const long_opt, const char **const begin,
                          size_t *const len, int *const argv_index);
@@ -84,8 +645,81 @@ int Argparser_bool_result(const Argparser *const parser, const char short_opt,
                           const char *const long_opt, const char **const begin,
                           int *const argv_index);
 
+/* Iterate over all occurrences of an ARG_FLAG_ACCUMULATE option in argv
+ * order. The count is given by the other Argparser_*_result functions. */
+const ArgparseOccurrence *
+Argparser_first_occurrence(const Argparser *const parser, const char short_opt,
+                           const char *const long_opt);
+
+const ArgparseOccurrence *
+Argparser_next_occurrence(const Argparser *const parser,
+                          const ArgparseOccurrence *const occ);
+
+/*
+ * Items of the last occurrence of a list option, in a contiguous array that
+ * stays valid until the results are reset. ARG_STR_LIST items point into
+ * the token. Returns NULL with *num_items set to 0 if the option did not
+ * occur or has another type. An empty value is an empty list, which is not
+ * NULL. With ARG_FLAG_ACCUMULATE, earlier occurrences keep only their text.
+ */
+const intmax_t *Argparser_int_list_result(const Argparser *const parser,
+                                          const char short_opt,
+                                          const char *const long_opt,
+                                          size_t *const num_items);
+
+const double *Argparser_float_list_result(const Argparser *const parser,
+                                          const char short_opt,
+                                          const char *const long_opt,
+                                          size_t *const num_items);
+
+const ArgparseSpan *Argparser_str_list_result(const Argparser *const parser,
+                                              const char short_opt,
+                                              const char *const long_opt,
+                                              size_t *const num_items);
+
+/*
+ * Long options starting with prefix, for shell completion. Stores up to
+ * max_matches of them and returns how many there are. With a lookup index
+ * (see ARGPARSER_INDEX_THRESHOLD and Argparser_freeze) matches are in strcmp
+ * order and found by binary search, otherwise in the order they were added
+ * and found by a scan. Options sharing a name count once, though without an
+ * index only names of the stored matches are known to be shared.
+ */
+size_t Argparser_complete(const Argparser *const parser,
+                          const char *const prefix,
+                          const ArgparseOpt **const matches,
+                          const size_t max_matches);
+
+/* Error of the last failed parse, with code ARG_ERROR_NONE if there was none
+ * since the last reset */
+const ArgparseError *Argparser_error(const Argparser *const parser);
+
+/* Format a message for error like snprintf(3), prefixed with the program
+ * name and without a newline. Returns the length of the whole message. */
+size_t Argparser_format_error(const Argparser *const parser,
+                              const ArgparseError *const error, char *const buf,
+                              const size_t size);
+
+/* Statistics of the parser's own results since initialization or the last
+ * Argparser_reset_stats. Use Argparser_results_view for other results. */
+const ArgparseStats *Argparser_stats(const Argparser *const parser);
+
+void Argparser_reset_stats(Argparser *const parser);
+
+/* Format stats like snprintf(3), one "name value" line per counter, for
+ * feeding into metrics. Returns the length of the whole text. */
+size_t Argparser_dump_stats(const ArgparseStats *const stats, char *const buf,
+                            const size_t size);
+
+/* Subcommand selected by the last parse, or NULL */
+const ArgparseSubcommand *Argparser_subcommand(const Argparser *const parser);
+
 size_t Argparser_num_pos_args(const Argparser *const parser);
 
+/* Token with the given argv index in the last parse, including response file
+ * tokens, or NULL */
+const char *Argparser_arg(const Argparser *const parser, const int argv_index);
+
 int Argparser_get_pos_arg(const Argparser *const parser, const size_t pos,
                           int *const argv_index);
 
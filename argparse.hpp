@@ -0,0 +1,345 @@
+/*##############################################################################
+#                                                                              #
+#                           Copyright 2018 C. P. Tam                           #
+#                                                                              #
+#       The argparse project is covered by the terms of the MIT License.       #
+#       See the file "LICENSE" for details.                                    #
+#                                                                              #
+##############################################################################*/
+
+/*
+ * Typed C++17 front-end over an Argparser_struct parser. Options are
+ * constexpr objects with static storage, and a parser is declared over
+ * references to them:
+ *
+ *     static constexpr argparse::option<bool> verbose{'v', "verbose"};
+ *     static constexpr argparse::option<std::int32_t> jobs{'j', "jobs"};
+ *     static constexpr argparse::option<std::string_view> out{'o', "output"};
+ *
+ *     argparse::parser<1, verbose, jobs, out> parser(argv[0]);
+ *     if (parser.parse(argc, argv)) ...
+ *     std::optional<std::int32_t> n = parser.get<jobs>();
+ *
+ * The option table, a hash table over the names and each option's index are
+ * computed at compile time, so the parser needs no heap allocation beyond
+ * what parsing itself needs (see ArgparseAllocator), and get<> reads the
+ * option's results directly. Strings are views into argv.
+ */
+
+#ifndef ARGPARSE_HPP_5A4F0C7E2B9D4E318C6A1F0D7B3E9C24
+#define ARGPARSE_HPP_5A4F0C7E2B9D4E318C6A1F0D7B3E9C24
+
+#include "argparse.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+namespace argparse {
+
+/* Items of the last occurrence of a list option, valid until the results are
+ * reset, see Argparser_int_list_result */
+template <typename T> struct list {
+    using value_type = T;
+
+    const T *items;
+    std::size_t num_items;
+
+    const T *begin() const { return items; }
+    const T *end() const { return items + num_items; }
+    std::size_t size() const { return num_items; }
+    const T &operator[](const std::size_t i) const { return items[i]; }
+};
+
+/* ArgparseType of the values of option<T> */
+template <typename T> struct arg_type;
+template <>
+struct arg_type<bool> : std::integral_constant<ArgparseType, ARG_BOOL> {};
+template <>
+struct arg_type<double> : std::integral_constant<ArgparseType, ARG_FLOAT> {};
+template <>
+struct arg_type<std::string_view>
+    : std::integral_constant<ArgparseType, ARG_STR> {};
+template <>
+struct arg_type<std::int8_t> : std::integral_constant<ArgparseType, ARG_INT8> {
+};
+template <>
+struct arg_type<std::int16_t>
+    : std::integral_constant<ArgparseType, ARG_INT16> {};
+template <>
+struct arg_type<std::int32_t>
+    : std::integral_constant<ArgparseType, ARG_INT32> {};
+template <>
+struct arg_type<std::int64_t>
+    : std::integral_constant<ArgparseType, ARG_INT64> {};
+template <>
+struct arg_type<std::uint8_t>
+    : std::integral_constant<ArgparseType, ARG_UINT8> {};
+template <>
+struct arg_type<std::uint16_t>
+    : std::integral_constant<ArgparseType, ARG_UINT16> {};
+template <>
+struct arg_type<std::uint32_t>
+    : std::integral_constant<ArgparseType, ARG_UINT32> {};
+template <>
+struct arg_type<std::uint64_t>
+    : std::integral_constant<ArgparseType, ARG_UINT64> {};
+template <>
+struct arg_type<list<std::intmax_t>>
+    : std::integral_constant<ArgparseType, ARG_INT_LIST> {};
+template <>
+struct arg_type<list<double>>
+    : std::integral_constant<ArgparseType, ARG_FLOAT_LIST> {};
+/* String items are views into the token */
+template <>
+struct arg_type<list<ArgparseSpan>>
+    : std::integral_constant<ArgparseType, ARG_STR_LIST> {};
+
+/* An option taking a T, or a flag for T = bool. short_opt may be '\0' and
+ * long_opt nullptr, but not both. flags are from ArgparseFlag. */
+template <typename T> struct option {
+    using value_type = T;
+    static constexpr ArgparseType type = arg_type<T>::value;
+
+    char short_opt;
+    const char *long_opt;
+    unsigned flags = 0;
+};
+
+namespace detail {
+
+template <typename T> struct is_list : std::false_type {};
+template <typename T> struct is_list<list<T>> : std::true_type {};
+
+constexpr std::size_t length(const char *const s) {
+    std::size_t len = 0;
+    while (s[len])
+        ++len;
+    return len;
+}
+
+constexpr bool equal(const char *const a, const char *const b,
+                     const std::size_t len) {
+    for (std::size_t i = 0; i < len; ++i)
+        if (a[i] != b[i])
+            return false;
+    return true;
+}
+
+/* FNV-1a, as in argparse.c */
+constexpr std::uint32_t hash(const char *const s, const std::size_t len) {
+    std::uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i < len; ++i)
+        h = (h ^ static_cast<unsigned char>(s[i])) * 16777619u;
+    return h;
+}
+
+/* Smallest power of two with a load factor of at most 1/2 */
+constexpr std::size_t num_slots(const std::size_t num_opts) {
+    std::size_t n = 1;
+    while (n < 2 * num_opts)
+        n *= 2;
+    return n;
+}
+
+/* The name of one option, as seen by the compile-time tables */
+struct name {
+    char short_opt;
+    const char *long_opt;
+};
+
+/* Nonzero unless two options share a short or long name */
+template <std::size_t N>
+constexpr bool unique(const std::array<name, N> &names) {
+    for (std::size_t i = 0; i < N; ++i) {
+        if (!names[i].short_opt && !names[i].long_opt)
+            return false;
+        for (std::size_t j = 0; j < i; ++j) {
+            if (names[i].short_opt && names[i].short_opt == names[j].short_opt)
+                return false;
+            if (names[i].long_opt && names[j].long_opt) {
+                const std::size_t len = length(names[i].long_opt);
+                if (len == length(names[j].long_opt) &&
+                    equal(names[i].long_opt, names[j].long_opt, len))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Option index plus one for each short option char, 0 if none */
+template <std::size_t N>
+constexpr std::array<std::uint32_t, 256>
+short_slots(const std::array<name, N> &names) {
+    std::array<std::uint32_t, 256> slots{};
+    for (std::size_t i = 0; i < N; ++i)
+        if (names[i].short_opt)
+            slots[static_cast<unsigned char>(names[i].short_opt)] =
+                static_cast<std::uint32_t>(i + 1);
+    return slots;
+}
+
+/* Open addressing over the long names, holding option indices plus one */
+template <std::size_t N>
+constexpr std::array<std::uint32_t, num_slots(N)>
+long_slots(const std::array<name, N> &names) {
+    std::array<std::uint32_t, num_slots(N)> slots{};
+    for (std::size_t i = 0; i < N; ++i) {
+        if (!names[i].long_opt)
+            continue;
+        std::size_t slot =
+            hash(names[i].long_opt, length(names[i].long_opt)) &
+            (num_slots(N) - 1);
+        while (slots[slot])
+            slot = (slot + 1) & (num_slots(N) - 1);
+        slots[slot] = static_cast<std::uint32_t>(i + 1);
+    }
+    return slots;
+}
+
+} // namespace detail
+
+/*
+ * A parser over the options Opts, with at most MaxPosArgs positional
+ * arguments. It points into itself, so it can be neither copied nor moved.
+ */
+template <std::size_t MaxPosArgs, const auto &...Opts> class parser {
+  public:
+    static constexpr std::size_t num_opts = sizeof...(Opts);
+
+    explicit parser(const char *const prog_name, const unsigned flags = 0)
+        : opts_{{{Opts.short_opt, const_cast<char *>(Opts.long_opt),
+                  std::decay_t<decltype(Opts)>::type, Opts.flags,
+                  nullptr}...}},
+          states_{}, pos_args_{}, parser_ Argparser_struct_states_lookup(
+                                      prog_name, num_opts, opts_.data(),
+                                      states_.data(), MaxPosArgs,
+                                      pos_args_.data(), lookup) {
+        parser_.flags = flags;
+    }
+
+    parser(const parser &) = delete;
+    parser &operator=(const parser &) = delete;
+
+    ~parser() { Argparser_deinit(&parser_); }
+
+    /* Parse a command line, see Argparser_parse and error() */
+    int parse(const int argc, const char *const *const argv) {
+        return Argparser_parse(&parser_, argc, argv);
+    }
+
+    void reset() { Argparser_reset(&parser_); }
+
+    /* The value of Opt, or whether a bool option was given. nullopt if the
+     * option was not given or, with ARGPARSER_LAZY_CONVERSION, its value is
+     * bad. A list option given an empty value has an empty list. */
+    template <const auto &Opt> auto get() const {
+        using T = typename std::decay_t<decltype(Opt)>::value_type;
+        const ArgparseOptState &state = converted_state<Opt>();
+        if constexpr (std::is_same_v<T, bool>) {
+            return state.count > 0;
+        } else {
+            if (!state.count || state.conversion != ARG_CONVERSION_OK)
+                return std::optional<T>();
+            if constexpr (std::is_same_v<T, std::string_view>)
+                return std::optional<T>(std::in_place, state.begin,
+                                        state.val_strlen);
+            else if constexpr (detail::is_list<T>::value)
+                return std::optional<T>(T{
+                    static_cast<const typename T::value_type *>(state.items),
+                    state.num_items});
+            else if constexpr (std::is_same_v<T, double>)
+                return std::optional<T>(state.float_val);
+            else if constexpr (std::is_unsigned_v<T>)
+                return std::optional<T>(static_cast<T>(state.uint_val));
+            else
+                return std::optional<T>(static_cast<T>(state.int_val));
+        }
+    }
+
+    /* How many times Opt was given */
+    template <const auto &Opt> int count() const {
+        return states_[index_of<Opt>()].count;
+    }
+
+    /* The token Opt was last given in, see Argparser_arg */
+    template <const auto &Opt> int argv_index() const {
+        return states_[index_of<Opt>()].argv_index;
+    }
+
+    std::size_t num_pos_args() const {
+        return Argparser_num_pos_args(&parser_);
+    }
+
+    /* The pos-th positional argument, which must exist */
+    std::string_view pos_arg(const std::size_t pos) const {
+        return Argparser_arg(&parser_, pos_args_[pos]);
+    }
+
+    const ArgparseError &error() const { return *Argparser_error(&parser_); }
+
+    /* For the rest of the C API */
+    Argparser *c_parser() { return &parser_; }
+    const Argparser *c_parser() const { return &parser_; }
+
+  private:
+    static constexpr std::array<detail::name, num_opts> names_{
+        {{Opts.short_opt, Opts.long_opt}...}};
+    static_assert(detail::unique(names_),
+                  "options must have a name, and names must be unique");
+    static constexpr auto short_slots_ = detail::short_slots(names_);
+    static constexpr auto long_slots_ = detail::long_slots(names_);
+
+    /* Index of Opt in Opts, a compile-time constant */
+    template <const auto &Opt> static constexpr std::size_t index_of() {
+        constexpr const void *addrs[] = {&Opts...};
+        std::size_t i = 0;
+        while (i < num_opts && addrs[i] != &Opt)
+            ++i;
+        return i;
+    }
+
+    template <const auto &Opt> const ArgparseOptState &converted_state() const {
+        constexpr std::size_t i = index_of<Opt>();
+        static_assert(i < num_opts, "option is not one of this parser's");
+        const ArgparseOptState &state = states_[i];
+        /* Converting goes through the C API, by index, so that no name is
+         * looked up */
+        if (state.conversion == ARG_CONVERSION_PENDING)
+            Argparser_convert_index(&parser_, i);
+        return state;
+    }
+
+    /* Lookup hook over the compile-time tables */
+    static ArgparseOpt *lookup(const Argparser *const parser,
+                               const char short_opt,
+                               const char *const long_opt,
+                               const std::size_t len) {
+        if (short_opt) {
+            const std::uint32_t i =
+                short_slots_[static_cast<unsigned char>(short_opt)];
+            return i ? parser->opts + i - 1 : nullptr;
+        }
+        constexpr std::size_t mask = long_slots_.size() - 1;
+        for (std::size_t slot = detail::hash(long_opt, len) & mask;
+             long_slots_[slot]; slot = (slot + 1) & mask) {
+            const char *const name = names_[long_slots_[slot] - 1].long_opt;
+            if (detail::equal(name, long_opt, len) && !name[len])
+                return parser->opts + long_slots_[slot] - 1;
+        }
+        return nullptr;
+    }
+
+    /* One spare element each keeps the arrays nonempty */
+    std::array<ArgparseOpt, num_opts + 1> opts_;
+    std::array<ArgparseOptState, num_opts + 1> states_;
+    std::array<int, MaxPosArgs + 1> pos_args_;
+    Argparser parser_;
+};
+
+} // namespace argparse
+
+#endif /* ARGPARSE_HPP_5A4F0C7E2B9D4E318C6A1F0D7B3E9C24 */
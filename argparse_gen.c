@@ -0,0 +1,572 @@
+/*##############################################################################
+#                                                                              #
+#                           Copyright 2018 C. P. Tam                           #
+#                                                                              #
+#       The argparse project is covered by the terms of the MIT License.       #
+#       See the file "LICENSE" for details.                                    #
+#                                                                              #
+##############################################################################*/
+
+/*
+ * argparse-gen: emit a C header with a static option table and a perfect-hash
+ * lookup for it, so that a parser can be set up without any heap allocation.
+ *
+ * Spec format, one entry per line, '#' starts a comment:
+ *
+ *     <short|-> <long|-> <type> [flags]
+ *     %positional <max positional arguments>
+ *
+ * where type is int, float, str, bool, int8, int16, int32, int64, uint,
+ * uint8, uint16, uint32, uint64, int_list, float_list or str_list, and flags
+ * is a comma-separated list of accumulate, hex, size_suffix and, for list
+ * types, delimiter=C, see ArgparseFlag. Lists are comma-separated unless a
+ * delimiter is given.
+ *
+ * The generated header defines PREFIX_opts, PREFIX_states, PREFIX_pos_args,
+ * PREFIX_lookup and PREFIX_PARSER(prog_name), which initializes an Argparser
+ * usable with Argparser_parse and the Argparser_*_result functions. The
+ * option table is const: parsers never write to it.
+ */
+
+#include "argparse.h"
+#include <ctype.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPEC_LINE_MAX 1024
+#define DEFAULT_MAX_POS_ARGS 16
+/* Displacements with this bit set store the slot directly */
+#define DIRECT_SLOT 0x80000000u
+#define MAX_SEED 0x1000000u
+
+typedef struct SpecOpt {
+    char short_opt;
+    char *long_opt;
+    size_t len;
+    const char *type;
+    unsigned flags;
+    /* Delimiter of a list option, '\0' for the default */
+    char delimiter;
+} SpecOpt;
+
+typedef struct Spec {
+    size_t num_opts, opts_capacity;
+    intmax_t max_pos_args;
+    SpecOpt *opts;
+} Spec;
+
+static const struct {
+    const char *name, *type;
+} spec_types[] = {{"int", "ARG_INT"},       {"float", "ARG_FLOAT"},
+                  {"str", "ARG_STR"},       {"bool", "ARG_BOOL"},
+                  {"int8", "ARG_INT8"},     {"int16", "ARG_INT16"},
+                  {"int32", "ARG_INT32"},   {"int64", "ARG_INT64"},
+                  {"uint", "ARG_UINT"},     {"uint8", "ARG_UINT8"},
+                  {"uint16", "ARG_UINT16"}, {"uint32", "ARG_UINT32"},
+                  {"uint64", "ARG_UINT64"}, {"int_list", "ARG_INT_LIST"},
+                  {"float_list", "ARG_FLOAT_LIST"},
+                  {"str_list", "ARG_STR_LIST"}};
+
+static const struct {
+    const char *name, *flag;
+    unsigned value;
+} spec_flags[] = {
+    {"accumulate", "ARG_FLAG_ACCUMULATE", ARG_FLAG_ACCUMULATE},
+    {"hex", "ARG_FLAG_HEX", ARG_FLAG_HEX},
+    {"size_suffix", "ARG_FLAG_SIZE_SUFFIX", ARG_FLAG_SIZE_SUFFIX}};
+
+/* Emitted verbatim into the generated header, and must match Gen_hash */
+static const char *const hash_source =
+    "static inline uint32_t %s_hash(const char *const name, const size_t len,\n"
+    "        const uint32_t seed) {\n"
+    "    uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);\n"
+    "    for (size_t i = 0; i < len; ++i)\n"
+    "        hash = (hash ^ (unsigned char)name[i]) * 16777619u;\n"
+    "    hash ^= hash >> 16;\n"
+    "    hash *= 0x7feb352du;\n"
+    "    hash ^= hash >> 15;\n"
+    "    hash *= 0x846ca68bu;\n"
+    "    return hash ^ (hash >> 16);\n"
+    "}\n";
+
+static uint32_t Gen_hash(const char *const name, const size_t len,
+                         const uint32_t seed) {
+    uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (size_t i = 0; i < len; ++i)
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    hash *= 0x846ca68bu;
+    return hash ^ (hash >> 16);
+}
+
+static void Spec_deinit(Spec *const spec) {
+    for (size_t i = 0; i < spec->num_opts; ++i)
+        free(spec->opts[i].long_opt);
+    free(spec->opts);
+}
+
+/* Parse the comma-separated flags of an option */
+static int Spec_add_flags(SpecOpt *const opt, const char *const path,
+                          const size_t line_no, const char *flag) {
+    for (;;) {
+        size_t len = strcspn(flag, ",");
+        if (strncmp(flag, "delimiter=", 10) == 0 &&
+            isgraph((unsigned char)flag[10]) &&
+            (flag[11] == ',' || !flag[11])) {
+            /* The delimiter may itself be a comma */
+            opt->delimiter = flag[10];
+            len = 11;
+        } else {
+            size_t i = 0;
+            while (i < sizeof spec_flags / sizeof spec_flags[0] &&
+                   (strlen(spec_flags[i].name) != len ||
+                    strncmp(flag, spec_flags[i].name, len) != 0))
+                ++i;
+            if (i == sizeof spec_flags / sizeof spec_flags[0]) {
+                fprintf(stderr, "%s:%zu: unknown flag '%.*s'\n", path,
+                        line_no, (int)len, flag);
+                return 1;
+            }
+            opt->flags |= spec_flags[i].value;
+        }
+        if (!flag[len])
+            return 0;
+        flag += len + 1;
+    }
+}
+
+/* Parse one non-empty, non-comment line of the spec */
+static int Spec_add_line(Spec *const spec, const char *const path,
+                         const size_t line_no, char *const line) {
+    char *fields[4];
+    size_t num_fields = 0;
+    for (char *tok = strtok(line, " \t\r\n"); tok;
+         tok = strtok(NULL, " \t\r\n")) {
+        if (num_fields == 4) {
+            num_fields = 5;
+            break;
+        }
+        fields[num_fields++] = tok;
+    }
+
+    if (fields[0][0] == '%') {
+        char *endptr;
+        if (strcmp(fields[0], "%positional") != 0 || num_fields != 2) {
+            fprintf(stderr, "%s:%zu: unknown directive '%s'\n", path, line_no,
+                    fields[0]);
+            return 1;
+        }
+        spec->max_pos_args = strtoimax(fields[1], &endptr, 10);
+        if (*endptr || spec->max_pos_args < 0 || spec->max_pos_args > INT_MAX) {
+            fprintf(stderr,
+                    "%s:%zu: '%s' is not a valid number of positional "
+                    "arguments\n",
+                    path, line_no, fields[1]);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (num_fields != 3 && num_fields != 4) {
+        fprintf(stderr, "%s:%zu: expected '<short> <long> <type> [flags]'\n",
+                path, line_no);
+        return 1;
+    }
+
+    SpecOpt opt = {0};
+    if (strcmp(fields[0], "-") != 0) {
+        if (fields[0][1] || fields[0][0] == '-' ||
+            !isgraph((unsigned char)fields[0][0])) {
+            fprintf(stderr, "%s:%zu: invalid short option '%s'\n", path,
+                    line_no, fields[0]);
+            return 1;
+        }
+        opt.short_opt = fields[0][0];
+    }
+    if (strcmp(fields[1], "-") != 0) {
+        if (strchr(fields[1], '=') || strchr(fields[1], '"') ||
+            strchr(fields[1], '\\')) {
+            fprintf(stderr, "%s:%zu: invalid long option '%s'\n", path,
+                    line_no, fields[1]);
+            return 1;
+        }
+        opt.len = strlen(fields[1]);
+        if (!(opt.long_opt = malloc(opt.len + 1)))
+            return 1;
+        memcpy(opt.long_opt, fields[1], opt.len + 1);
+    }
+    for (size_t i = 0; i < sizeof spec_types / sizeof spec_types[0]; ++i)
+        if (strcmp(fields[2], spec_types[i].name) == 0)
+            opt.type = spec_types[i].type;
+    if (!opt.type || (!opt.short_opt && !opt.long_opt)) {
+        fprintf(stderr, "%s:%zu: %s\n", path, line_no,
+                opt.type ? "option has neither a short nor a long name"
+                         : "unknown type");
+        free(opt.long_opt);
+        return 1;
+    }
+    if (num_fields == 4 &&
+        Spec_add_flags(&opt, path, line_no, fields[3])) {
+        free(opt.long_opt);
+        return 1;
+    }
+    if (opt.delimiter && !strstr(opt.type, "_LIST")) {
+        fprintf(stderr, "%s:%zu: only list options have a delimiter\n", path,
+                line_no);
+        free(opt.long_opt);
+        return 1;
+    }
+
+    for (size_t i = 0; i < spec->num_opts; ++i) {
+        const SpecOpt *other = spec->opts + i;
+        if ((opt.short_opt && opt.short_opt == other->short_opt) ||
+            (opt.long_opt && other->long_opt &&
+             strcmp(opt.long_opt, other->long_opt) == 0)) {
+            fprintf(stderr, "%s:%zu: duplicate option\n", path, line_no);
+            free(opt.long_opt);
+            return 1;
+        }
+    }
+
+    /* Grow the opts array if needed */
+    if (spec->num_opts >= spec->opts_capacity) {
+        SpecOpt *new_opts;
+        spec->opts_capacity =
+            spec->opts_capacity ? 2 * spec->opts_capacity : 16;
+        if (!(new_opts = realloc(spec->opts,
+                                 spec->opts_capacity * sizeof *spec->opts))) {
+            free(opt.long_opt);
+            return 1;
+        }
+        spec->opts = new_opts;
+    }
+    spec->opts[spec->num_opts++] = opt;
+    return 0;
+}
+
+static int Spec_read(Spec *const spec, const char *const path) {
+    FILE *file;
+    if (!(file = fopen(path, "r"))) {
+        perror(path);
+        return 1;
+    }
+
+    char line[SPEC_LINE_MAX];
+    size_t line_no = 0;
+    int ret = 0;
+    while (!ret && fgets(line, sizeof line, file)) {
+        ++line_no;
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+        if (strspn(line, " \t\r\n") == strlen(line))
+            continue;
+        ret = Spec_add_line(spec, path, line_no, line);
+    }
+    if (!ret && ferror(file)) {
+        perror(path);
+        ret = 1;
+    }
+    fclose(file);
+    return ret;
+}
+
+typedef struct Bucket {
+    size_t id, size;
+    const size_t *keys;
+} Bucket;
+
+static int Bucket_cmp_size(const void *a, const void *b) {
+    const size_t size_a = ((const Bucket *)a)->size;
+    const size_t size_b = ((const Bucket *)b)->size;
+    return (size_a < size_b) - (size_a > size_b);
+}
+
+/*
+ * Hash-and-displace minimal perfect hash over the n long options in keys.
+ * Key i goes to bucket hash(key, 0) % n, and every bucket gets the smallest
+ * seed that moves all of its keys to free slots of an n-slot table. Buckets
+ * with one key are placed directly. Fills disps and slots (option indices),
+ * each of size n.
+ */
+static int Gen_perfect_hash(const Spec *const spec, const size_t *const keys,
+                            const size_t n, uint32_t *const disps,
+                            size_t *const slots) {
+    int ret = 1;
+    Bucket *buckets = calloc(n, sizeof *buckets);
+    size_t *bucket_keys = malloc(n * sizeof *bucket_keys);
+    size_t *bucket_of = malloc(n * sizeof *bucket_of);
+    size_t *candidate = malloc(n * sizeof *candidate);
+    char *taken = calloc(n, 1);
+    if (!buckets || !bucket_keys || !bucket_of || !candidate || !taken)
+        goto perfect_hash_exit;
+
+    /* Counting sort of the keys into their buckets */
+    for (size_t i = 0; i < n; ++i) {
+        const SpecOpt *opt = spec->opts + keys[i];
+        bucket_of[i] = Gen_hash(opt->long_opt, opt->len, 0) % n;
+        ++buckets[bucket_of[i]].size;
+    }
+    for (size_t b = 0, end = 0; b < n; ++b) {
+        buckets[b].id = b;
+        buckets[b].keys = bucket_keys + end;
+        end += buckets[b].size;
+        buckets[b].size = 0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        Bucket *bucket = buckets + bucket_of[i];
+        bucket_keys[bucket->keys - bucket_keys + bucket->size++] = keys[i];
+    }
+
+    /* Place the largest buckets first, while the table is mostly empty */
+    qsort(buckets, n, sizeof *buckets, Bucket_cmp_size);
+    memset(disps, 0, n * sizeof *disps);
+    size_t next_free = 0;
+    for (size_t b = 0; b < n && buckets[b].size; ++b) {
+        const Bucket *bucket = buckets + b;
+        if (bucket->size == 1) {
+            while (taken[next_free])
+                ++next_free;
+            taken[next_free] = 1;
+            slots[next_free] = bucket->keys[0];
+            disps[bucket->id] = DIRECT_SLOT | (uint32_t)next_free;
+            continue;
+        }
+
+        uint32_t seed;
+        for (seed = 1; seed < MAX_SEED; ++seed) {
+            size_t k;
+            for (k = 0; k < bucket->size; ++k) {
+                const SpecOpt *opt = spec->opts + bucket->keys[k];
+                candidate[k] = Gen_hash(opt->long_opt, opt->len, seed) % n;
+                if (taken[candidate[k]])
+                    break;
+                taken[candidate[k]] = 1;
+            }
+            if (k == bucket->size)
+                break;
+            /* Undo the partial placement */
+            while (k--)
+                taken[candidate[k]] = 0;
+        }
+        if (seed == MAX_SEED) {
+            fprintf(stderr, "argparse-gen: no perfect hash found\n");
+            goto perfect_hash_exit;
+        }
+        for (size_t k = 0; k < bucket->size; ++k)
+            slots[candidate[k]] = bucket->keys[k];
+        disps[bucket->id] = seed;
+    }
+    ret = 0;
+
+perfect_hash_exit:
+    free(buckets);
+    free(bucket_keys);
+    free(bucket_of);
+    free(candidate);
+    free(taken);
+    return ret;
+}
+
+static void Gen_char_literal(FILE *const out, const char c) {
+    if (c == '\'' || c == '\\')
+        fprintf(out, "'\\%c'", c);
+    else
+        fprintf(out, "'%c'", c);
+}
+
+static int Gen_header(const Spec *const spec, const char *const prefix,
+                      const char *const spec_path, FILE *const out) {
+    int ret = 1;
+    size_t n = 0;
+    size_t *keys = malloc((spec->num_opts + 1) * sizeof *keys);
+    uint32_t *disps = malloc((spec->num_opts + 1) * sizeof *disps);
+    size_t *slots = malloc((spec->num_opts + 1) * sizeof *slots);
+    if (!keys || !disps || !slots)
+        goto header_exit;
+    for (size_t i = 0; i < spec->num_opts; ++i)
+        if (spec->opts[i].long_opt)
+            keys[n++] = i;
+    if (n && Gen_perfect_hash(spec, keys, n, disps, slots))
+        goto header_exit;
+
+    fprintf(out,
+            "/* Generated by argparse-gen from %s, do not edit */\n\n"
+            "#ifndef ARGPARSE_GEN_%s_H\n"
+            "#define ARGPARSE_GEN_%s_H\n\n"
+            "#include \"argparse.h\"\n"
+            "#include <stddef.h>\n"
+            "#include <stdint.h>\n"
+            "#include <string.h>\n\n",
+            spec_path, prefix, prefix);
+
+    fprintf(out, "#define %s_NUM_OPTS %zu\n", prefix, spec->num_opts);
+    fprintf(out, "#define %s_MAX_POS_ARGS %" PRIiMAX "\n\n", prefix,
+            spec->max_pos_args);
+
+    fprintf(out, "static const ArgparseOpt %s_opts[%s_NUM_OPTS + 1] = {\n",
+            prefix, prefix);
+    for (size_t i = 0; i < spec->num_opts; ++i) {
+        const SpecOpt *opt = spec->opts + i;
+        fprintf(out, "    {.short_opt = ");
+        if (opt->short_opt)
+            Gen_char_literal(out, opt->short_opt);
+        else
+            fprintf(out, "'\\0'");
+        if (opt->long_opt)
+            fprintf(out, ", .long_opt = \"%s\"", opt->long_opt);
+        fprintf(out, ", .type = %s", opt->type);
+        const char *sep = ", .flags = ";
+        for (size_t j = 0; j < sizeof spec_flags / sizeof spec_flags[0]; ++j) {
+            if (opt->flags & spec_flags[j].value) {
+                fprintf(out, "%s%s", sep, spec_flags[j].flag);
+                sep = " | ";
+            }
+        }
+        if (opt->delimiter) {
+            fprintf(out, "%sARG_FLAG_DELIMITER(", sep);
+            Gen_char_literal(out, opt->delimiter);
+            fprintf(out, ")");
+        }
+        fprintf(out, "},\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out,
+            "static ArgparseOptState %s_states[%s_NUM_OPTS + 1]\n"
+            "    __attribute__((unused));\n"
+            "static int %s_pos_args[%s_MAX_POS_ARGS + 1]\n"
+            "    __attribute__((unused));\n\n",
+            prefix, prefix, prefix, prefix);
+
+    if (n) {
+        fprintf(out, hash_source, prefix);
+        fprintf(out, "\nstatic const uint32_t %s_disps[%zu] = {", prefix, n);
+        for (size_t i = 0; i < n; ++i)
+            fprintf(out, "%s0x%08" PRIx32 "u,", i % 6 ? " " : "\n    ",
+                    disps[i]);
+        fprintf(out, "\n};\n\n");
+        fprintf(out, "static const unsigned short %s_slots[%zu] = {", prefix,
+                n);
+        for (size_t i = 0; i < n; ++i)
+            fprintf(out, "%s%zu,", i % 10 ? " " : "\n    ", slots[i]);
+        fprintf(out, "\n};\n\n");
+    }
+
+    fprintf(out,
+            "static inline ArgparseOpt *\n"
+            "%s_lookup(const Argparser *const parser,\n"
+            "        const char short_opt, const char *const long_opt,\n"
+            "        const size_t len) {\n"
+            "    switch (short_opt) {\n",
+            prefix);
+    for (size_t i = 0; i < spec->num_opts; ++i) {
+        if (!spec->opts[i].short_opt)
+            continue;
+        fprintf(out, "    case ");
+        Gen_char_literal(out, spec->opts[i].short_opt);
+        fprintf(out, ":\n        return parser->opts + %zu;\n", i);
+    }
+    fprintf(out, "    case '\\0':\n"
+                 "        break;\n"
+                 "    default:\n"
+                 "        return NULL;\n"
+                 "    }\n");
+    if (n) {
+        fprintf(out,
+                "    uint32_t slot =\n"
+                "        %s_disps[%s_hash(long_opt, len, 0) %% %zu];\n"
+                "    if (slot & 0x%08" PRIx32 "u)\n"
+                "        slot &= ~0x%08" PRIx32 "u;\n"
+                "    else\n"
+                "        slot = %s_hash(long_opt, len, slot) %% %zu;\n"
+                "    ArgparseOpt *opt = parser->opts + %s_slots[slot];\n"
+                "    if (strncmp(opt->long_opt, long_opt, len) == 0 &&\n"
+                "        opt->long_opt[len] == '\\0')\n"
+                "        return opt;\n"
+                "    return NULL;\n"
+                "}\n\n",
+                prefix, prefix, n, DIRECT_SLOT, DIRECT_SLOT, prefix, n, prefix);
+    } else {
+        fprintf(out, "    (void)parser;\n"
+                     "    (void)long_opt;\n"
+                     "    (void)len;\n"
+                     "    return NULL;\n"
+                     "}\n\n");
+    }
+
+    fprintf(out,
+            "#define %s_PARSER(prog_name) \\\n"
+            "    Argparser_struct_states_lookup(prog_name, %s_NUM_OPTS, \\\n"
+            "        (ArgparseOpt *)%s_opts, %s_states, %s_MAX_POS_ARGS, \\\n"
+            "        %s_pos_args, %s_lookup)\n\n"
+            "#endif\n",
+            prefix, prefix, prefix, prefix, prefix, prefix, prefix);
+    ret = ferror(out) != 0;
+
+header_exit:
+    free(keys);
+    free(disps);
+    free(slots);
+    return ret;
+}
+
+int main(int argc, char const *argv[]) {
+    int exit_code = 1;
+
+    ArgparseOpt opts[] = {{'o', "output", ARG_STR, 0, NULL},
+                          {'p', "prefix", ARG_STR, 0, NULL}};
+    int pos_args[1];
+    const size_t num_opts = sizeof opts / sizeof opts[0];
+    const size_t max_pos_args = sizeof pos_args / sizeof pos_args[0];
+    Argparser parser =
+        Argparser_struct(argv[0], num_opts, opts, max_pos_args, pos_args);
+    parser.flags |= ARGPARSER_PRINT_ERRORS;
+    Spec spec = {0};
+    spec.max_pos_args = DEFAULT_MAX_POS_ARGS;
+
+    if (Argparser_parse(&parser, argc, argv))
+        goto main_exit;
+    int spec_index;
+    if (Argparser_get_pos_arg(&parser, 0, &spec_index)) {
+        fprintf(stderr, "usage: %s [-p PREFIX] [-o OUTPUT] SPEC\n", argv[0]);
+        goto main_exit;
+    }
+
+    const char *prefix = "args", *output = NULL;
+    Argparser_str_result(&parser, 'p', NULL, &prefix, NULL, NULL);
+    Argparser_str_result(&parser, 'o', NULL, &output, NULL, NULL);
+    for (const char *c = prefix; *c; ++c) {
+        if (!isalnum((unsigned char)*c) && *c != '_') {
+            fprintf(stderr, "%s: prefix '%s' is not a valid identifier\n",
+                    argv[0], prefix);
+            goto main_exit;
+        }
+    }
+
+    if (Spec_read(&spec, argv[spec_index]))
+        goto main_exit;
+    if (spec.num_opts > USHRT_MAX) {
+        fprintf(stderr, "%s: too many options\n", argv[0]);
+        goto main_exit;
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        perror(output);
+        goto main_exit;
+    }
+    exit_code = Gen_header(&spec, prefix, argv[spec_index], out);
+    if (output && fclose(out))
+        exit_code = 1;
+
+main_exit:
+    Spec_deinit(&spec);
+    Argparser_deinit(&parser);
+    return exit_code;
+}
@@ -0,0 +1,406 @@
+/*##############################################################################
+#                                                                              #
+#                           Copyright 2018 C. P. Tam                           #
+#                                                                              #
+#       The argparse project is covered by the terms of the MIT License.       #
+#       See the file "LICENSE" for details.                                    #
+#                                                                              #
+##############################################################################*/
+
+/*
+ * Benchmark of Argparser_parse against getopt_long on synthetic command
+ * lines. Prints one tab-separated line per workload and parser setup:
+ *
+ *     workload  setup  args  iterations  ns_per_arg  parses_per_sec
+ *     allocs_per_parse
+ *
+ * "static" parses with an Argparser_struct parser set up once and reset
+ * between parses, "cached" does the same with Argparser_set_cache, so that
+ * all but the first parse are cache hits, "dynamic" sets up a parser with
+ * Argparser_init and Argparser_add_argument for every parse, and "getopt"
+ * uses getopt_long and converts the values itself. Heap allocations are
+ * counted by wrapping malloc and friends at link time, see the bench target
+ * of the Makefile.
+ */
+
+#include "argparse.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_NUM_FILLERS 56
+#define BENCH_NUM_OPTS (8 + BENCH_NUM_FILLERS)
+#define BENCH_MAX_POS_ARGS 1024
+
+/* Allocation counting, with the real functions provided by --wrap */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static size_t bench_allocs;
+
+void *__wrap_malloc(const size_t size) {
+    ++bench_allocs;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(const size_t nmemb, const size_t size) {
+    ++bench_allocs;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *const ptr, const size_t size) {
+    ++bench_allocs;
+    return __real_realloc(ptr, size);
+}
+
+/* The option schema shared by all setups */
+static char filler_names[BENCH_NUM_FILLERS][8];
+static ArgparseOpt schema[BENCH_NUM_OPTS];
+static struct option getopt_opts[BENCH_NUM_OPTS + 1];
+static const char getopt_short[] = "vqxn:f:s:z:p:";
+
+static void bench_init_schema(void) {
+    static const ArgparseOpt fixed[] = {
+        {'v', "verbose", ARG_BOOL, 0, NULL},
+        {'q', "quiet", ARG_BOOL, 0, NULL},
+        {'x', "extra", ARG_BOOL, 0, NULL},
+        {'n', "int", ARG_INT, 0, NULL},
+        {'f', "float", ARG_FLOAT, 0, NULL},
+        {'s', "str", ARG_STR, 0, NULL},
+        {'z', "size", ARG_UINT64, ARG_FLAG_SIZE_SUFFIX, NULL},
+        {'p', "payload", ARG_STR, 0, NULL}};
+    const size_t num_fixed = sizeof fixed / sizeof fixed[0];
+
+    for (size_t i = 0; i < BENCH_NUM_OPTS; ++i) {
+        if (i < num_fixed) {
+            schema[i] = fixed[i];
+        } else {
+            char *const name = filler_names[i - num_fixed];
+            snprintf(name, sizeof filler_names[0], "opt%zu", i - num_fixed);
+            schema[i] = (ArgparseOpt){'\0', name, ARG_STR, 0, NULL};
+        }
+        getopt_opts[i].name = schema[i].long_opt;
+        getopt_opts[i].has_arg =
+            schema[i].type == ARG_BOOL ? no_argument : required_argument;
+        getopt_opts[i].flag = NULL;
+        getopt_opts[i].val = schema[i].short_opt ? schema[i].short_opt
+                                                 : 256 + (int)i;
+    }
+}
+
+/* A synthetic command line, whose strings are kept in one fixed buffer */
+typedef struct Workload {
+    const char *name;
+    int argc;
+    const char **argv;
+    char *buf;
+    size_t buf_len, buf_capacity;
+} Workload;
+
+static void workload_add(Workload *const w, const char *const fmt,
+                         const char *const arg) {
+    const int len = snprintf(NULL, 0, fmt, arg);
+    if (w->buf_len + (size_t)len + 1 > w->buf_capacity) {
+        fprintf(stderr, "bench: workload '%s' is too large\n", w->name);
+        exit(1);
+    }
+    snprintf(w->buf + w->buf_len, (size_t)len + 1, fmt, arg);
+    w->argv[w->argc++] = w->buf + w->buf_len;
+    w->buf_len += (size_t)len + 1;
+}
+
+static void workload_init(Workload *const w, const char *const name,
+                          const int max_args, const size_t buf_capacity) {
+    w->name = name;
+    w->argc = 0;
+    w->argv = malloc(((size_t)max_args + 1) * sizeof *w->argv);
+    w->buf = malloc(buf_capacity);
+    w->buf_len = 0;
+    w->buf_capacity = buf_capacity;
+    if (!w->argv || !w->buf) {
+        fprintf(stderr, "bench: out of memory\n");
+        exit(1);
+    }
+    workload_add(w, "%s", "bench");
+}
+
+static void workload_deinit(Workload *const w) {
+    free(w->argv);
+    free(w->buf);
+}
+
+static void build_small(Workload *const w) {
+    workload_init(w, "small", 8, 256);
+    workload_add(w, "%s", "-v");
+    workload_add(w, "%s", "--str=hello");
+    workload_add(w, "%s", "-n");
+    workload_add(w, "%s", "42");
+    workload_add(w, "%s", "input.txt");
+    workload_add(w, "%s", "output.txt");
+}
+
+static void build_short_bundles(Workload *const w) {
+    static const char *const bundles[] = {"-vvvv", "-qx", "-vqx", "-v",
+                                          "-xxvq", "-n7"};
+    workload_init(w, "short_bundles", 128, 4096);
+    for (int i = 0; i < 120; ++i)
+        workload_add(w, "%s", bundles[i % 6]);
+}
+
+static void build_long_kv(Workload *const w) {
+    workload_init(w, "long_kv", 128, 8192);
+    char value[32];
+    for (int i = 0; i < 120; ++i) {
+        snprintf(value, sizeof value, "opt%d=value%d", i % BENCH_NUM_FILLERS,
+                 i);
+        workload_add(w, "--%s", value);
+    }
+}
+
+static void build_numeric(Workload *const w) {
+    workload_init(w, "numeric", 128, 4096);
+    for (int i = 0; i < 30; ++i) {
+        workload_add(w, "%s", "-n");
+        workload_add(w, "%s", i % 2 ? "-123456789" : "42");
+        workload_add(w, "%s", i % 3 ? "--float=3.25" : "--float=6.02e23");
+        workload_add(w, "%s", i % 2 ? "--size=64k" : "-z1048576");
+    }
+}
+
+static void build_positional(Workload *const w) {
+    workload_init(w, "positional", 520, 16384);
+    char value[32];
+    for (int i = 0; i < 512; ++i) {
+        snprintf(value, sizeof value, "%d.txt", i);
+        workload_add(w, "file%s", value);
+        if (i % 128 == 0)
+            workload_add(w, "%s", "-v");
+    }
+}
+
+static void build_huge_value(Workload *const w) {
+    const size_t payload_len = (size_t)1 << 20;
+    char *const payload = malloc(payload_len + 1);
+    if (!payload) {
+        fprintf(stderr, "bench: out of memory\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < payload_len; ++i)
+        payload[i] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef"[i % 32];
+    payload[payload_len] = '\0';
+
+    workload_init(w, "huge_value", 8, 3 * payload_len);
+    workload_add(w, "--payload=%s", payload);
+    workload_add(w, "%s", "-v");
+    workload_add(w, "%s", "--str");
+    payload[payload_len / 2] = '\0';
+    workload_add(w, "%s", payload);
+    free(payload);
+}
+
+/* Keep results alive so that the compiler cannot drop the parsing */
+static volatile uintmax_t bench_sink;
+
+static int run_static(const Workload *const w, const size_t iterations) {
+    static ArgparseOptState states[BENCH_NUM_OPTS];
+    static int pos_args[BENCH_MAX_POS_ARGS];
+    Argparser parser =
+        Argparser_struct_states("bench", BENCH_NUM_OPTS, schema, states,
+                                BENCH_MAX_POS_ARGS, pos_args);
+    int status = Argparser_freeze(&parser);
+    for (size_t i = 0; !status && i < iterations; ++i) {
+        status = Argparser_parse(&parser, w->argc, w->argv);
+        bench_sink += Argparser_num_pos_args(&parser);
+        Argparser_reset(&parser);
+    }
+    Argparser_deinit(&parser);
+    return status;
+}
+
+static int run_cached(const Workload *const w, const size_t iterations) {
+    static ArgparseOptState states[BENCH_NUM_OPTS];
+    static int pos_args[BENCH_MAX_POS_ARGS];
+    Argparser parser =
+        Argparser_struct_states("bench", BENCH_NUM_OPTS, schema, states,
+                                BENCH_MAX_POS_ARGS, pos_args);
+    int status = Argparser_freeze(&parser) || Argparser_set_cache(&parser, 16);
+    for (size_t i = 0; !status && i < iterations; ++i) {
+        status = Argparser_parse(&parser, w->argc, w->argv);
+        bench_sink += Argparser_num_pos_args(&parser);
+        Argparser_reset(&parser);
+    }
+    Argparser_deinit(&parser);
+    return status;
+}
+
+static int run_dynamic(const Workload *const w, const size_t iterations) {
+    int status = 0;
+    for (size_t i = 0; !status && i < iterations; ++i) {
+        Argparser parser;
+        status = Argparser_init(&parser, "bench", -1);
+        for (size_t j = 0; !status && j < BENCH_NUM_OPTS; ++j)
+            status = Argparser_add_argument_flags(
+                &parser, schema[j].short_opt, schema[j].long_opt,
+                schema[j].type, schema[j].flags);
+        if (!status)
+            status = Argparser_parse(&parser, w->argc, w->argv);
+        bench_sink += Argparser_num_pos_args(&parser);
+        Argparser_deinit(&parser);
+    }
+    return status;
+}
+
+/* Size with an optional binary suffix, like ARG_FLAG_SIZE_SUFFIX */
+static uintmax_t getopt_size(const char *const arg) {
+    char *end;
+    const uintmax_t val = strtoumax(arg, &end, 10);
+    switch (*end | 0x20) {
+    case 'k':
+        return val << 10;
+    case 'm':
+        return val << 20;
+    case 'g':
+        return val << 30;
+    default:
+        return val;
+    }
+}
+
+static int run_getopt(const Workload *const w, const size_t iterations) {
+    char **const argv = malloc(((size_t)w->argc + 1) * sizeof *argv);
+    if (!argv)
+        return 1;
+    int status = 0;
+    opterr = 0;
+    for (size_t i = 0; !status && i < iterations; ++i) {
+        /* getopt_long permutes argv */
+        memcpy(argv, w->argv, (size_t)w->argc * sizeof *argv);
+        argv[w->argc] = NULL;
+        optind = 0;
+
+        struct {
+            int count;
+            const char *arg;
+            uintmax_t val;
+            double float_val;
+        } results[BENCH_NUM_OPTS] = {{0, NULL, 0, 0}};
+        int c, index;
+        while ((c = getopt_long(w->argc, argv, getopt_short, getopt_opts,
+                                &index)) != -1) {
+            size_t opt;
+            if (c == '?') {
+                status = 1;
+                break;
+            }
+            if (c >= 256)
+                opt = (size_t)(c - 256);
+            else
+                for (opt = 0; schema[opt].short_opt != c; ++opt)
+                    ;
+            ++results[opt].count;
+            results[opt].arg = optarg;
+            if (schema[opt].type == ARG_INT)
+                results[opt].val = (uintmax_t)strtoimax(optarg, NULL, 10);
+            else if (schema[opt].type == ARG_FLOAT)
+                results[opt].float_val = strtod(optarg, NULL);
+            else if (schema[opt].type == ARG_UINT64)
+                results[opt].val = getopt_size(optarg);
+        }
+        bench_sink += (uintmax_t)(w->argc - optind) + results[0].val;
+    }
+    free(argv);
+    return status;
+}
+
+typedef int (*BenchRun)(const Workload *w, size_t iterations);
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+/* Double the iterations until a run takes at least min_time seconds */
+static int bench(const Workload *const w, const char *const setup,
+                 const BenchRun run, const double min_time) {
+    size_t iterations = 1, allocs;
+    double elapsed;
+    if (run(w, 1)) {
+        fprintf(stderr, "bench: %s parser rejected workload '%s'\n", setup,
+                w->name);
+        return 1;
+    }
+    for (;; iterations *= 2) {
+        allocs = bench_allocs;
+        const double start = now();
+        if (run(w, iterations)) {
+            fprintf(stderr, "bench: %s parser failed on workload '%s'\n",
+                    setup, w->name);
+            return 1;
+        }
+        elapsed = now() - start;
+        allocs = bench_allocs - allocs;
+        if (elapsed >= min_time)
+            break;
+    }
+
+    const int args = w->argc - 1;
+    printf("%s\t%s\t%d\t%zu\t%.2f\t%.0f\t%.2f\n", w->name, setup, args,
+           iterations, 1e9 * elapsed / ((double)iterations * args),
+           (double)iterations / elapsed, (double)allocs / (double)iterations);
+    return 0;
+}
+
+int main(int argc, char const *argv[]) {
+    int exit_code = 0;
+
+    ArgparseOpt opts[] = {{'t', "time", ARG_FLOAT, 0, NULL},
+                          {'w', "workload", ARG_STR, 0, NULL}};
+    const size_t num_opts = sizeof opts / sizeof opts[0];
+    Argparser parser = Argparser_struct(argv[0], num_opts, opts, 0, NULL);
+    parser.flags |= ARGPARSER_PRINT_ERRORS;
+    if (Argparser_parse(&parser, argc, argv)) {
+        exit_code = 1;
+        goto main_exit;
+    }
+    int count;
+    double min_time = Argparser_float_result(&parser, 't', NULL, &count, NULL,
+                                             NULL, NULL);
+    if (!count)
+        min_time = 0.2;
+    const char *only = NULL;
+    Argparser_str_result(&parser, 'w', NULL, &only, NULL, NULL);
+
+    bench_init_schema();
+    void (*const builders[])(Workload *) = {
+        build_small,      build_short_bundles, build_long_kv,
+        build_numeric,    build_positional,    build_huge_value};
+    static const struct {
+        const char *name;
+        BenchRun run;
+    } setups[] = {{"static", run_static},
+                  {"cached", run_cached},
+                  {"dynamic", run_dynamic},
+                  {"getopt", run_getopt}};
+
+    printf("workload\tsetup\targs\titerations\tns_per_arg\tparses_per_sec\t"
+           "allocs_per_parse\n");
+    for (size_t i = 0; i < sizeof builders / sizeof builders[0]; ++i) {
+        Workload w;
+        builders[i](&w);
+        if (!only || !strcmp(only, w.name))
+            for (size_t j = 0; j < sizeof setups / sizeof setups[0]; ++j)
+                if (bench(&w, setups[j].name, setups[j].run, min_time))
+                    exit_code = 1;
+        workload_deinit(&w);
+    }
+
+main_exit:
+    Argparser_deinit(&parser);
+    return exit_code;
+}
@@ -16,15 +16,16 @@
 int main(int argc, char const *argv[]) {
     int exit_code = 0;
 
-    ArgparseOpt opts[] = {{'n', "int", ARG_INT},
-                          {'f', "float", ARG_FLOAT},
-                          {'v', "verbose", ARG_BOOL},
-                          {'s', "str", ARG_STR}};
+    ArgparseOpt opts[] = {{'n', "int", ARG_INT, 0, NULL},
+                          {'f', "float", ARG_FLOAT, 0, NULL},
+                          {'v', "verbose", ARG_BOOL, 0, NULL},
+                          {'s', "str", ARG_STR, 0, NULL}};
     int pos_args[10] = {0};
     const size_t num_opts = sizeof opts / sizeof opts[0];
     const size_t max_pos_args = sizeof pos_args / sizeof pos_args[0];
     Argparser parser =
         Argparser_struct(argv[0], num_opts, opts, max_pos_args, pos_args);
+    parser.flags |= ARGPARSER_RESPONSE_FILES | ARGPARSER_PRINT_ERRORS;
 
     /*Argparser parser;
     Argparser_init(&parser, argv[0], -1);
@@ -63,10 +64,10 @@ int main(int argc, char const *argv[]) {
     for (size_t i = 0; i < num_pos_args; ++i) {
         if (!Argparser_get_pos_arg(&parser, i, &argv_index))
             printf("Positional argument #%zu is '%s' at index %d.\n", i,
-                   argv[argv_index], argv_index);
+                   Argparser_arg(&parser, argv_index), argv_index);
     }
 
 main_exit:
-    /*Argparser_deinit(&parser);*/
+    Argparser_deinit(&parser);
     return exit_code;
 }
@@ -0,0 +1,243 @@
+/*##############################################################################
+#                                                                              #
+#                           Copyright 2018 C. P. Tam                           #
+#                                                                              #
+#       The argparse project is covered by the terms of the MIT License.       #
+#       See the file "LICENSE" for details.                                    #
+#                                                                              #
+##############################################################################*/
+
+/*
+ * Parse result cache: hits give the results an uncached parse would, with
+ * spans in the new argv, and entries are evicted least recently used first.
+ */
+
+#include "check.h"
+#include <stdlib.h>
+
+static int add_jobs(Argparser *const parser, void *const data) {
+    (void)data;
+    return Argparser_add_argument(parser, 'j', "jobs", ARG_UINT);
+}
+
+static int add_kill(Argparser *const parser, void *const data) {
+    (void)data;
+    return Argparser_add_argument(parser, 'k', "kill", ARG_BOOL);
+}
+
+static int init_parser(Argparser *const parser) {
+    return Argparser_init(parser, "cache", -1) ||
+           Argparser_add_argument_flags(parser, 'n', "num", ARG_INT,
+                                        ARG_FLAG_ACCUMULATE) ||
+           Argparser_add_argument(parser, 'f', "float", ARG_FLOAT) ||
+           Argparser_add_argument(parser, 's', "str", ARG_STR) ||
+           Argparser_add_argument(parser, 'v', "verbose", ARG_BOOL) ||
+           Argparser_add_argument(parser, 'l', "ints", ARG_INT_LIST) ||
+           Argparser_add_argument(parser, 'w', "words", ARG_STR_LIST) ||
+           Argparser_add_subcommand(parser, "run", add_jobs, NULL) ||
+           Argparser_add_subcommand(parser, "stop", add_kill, NULL);
+}
+
+/* A command line in buffers of its own, to be freed after parsing it */
+typedef struct Line {
+    int argc;
+    char **argv;
+} Line;
+
+static Line line_copy(const char *const *const argv) {
+    Line line = {0, NULL};
+    while (argv[line.argc])
+        ++line.argc;
+    line.argv = malloc((size_t)(line.argc + 1) * sizeof *line.argv);
+    for (int i = 0; i < line.argc; ++i) {
+        line.argv[i] = malloc(strlen(argv[i]) + 1);
+        strcpy(line.argv[i], argv[i]);
+    }
+    line.argv[line.argc] = NULL;
+    return line;
+}
+
+static void line_free(Line *const line) {
+    for (int i = 0; i < line->argc; ++i)
+        free(line->argv[i]);
+    free(line->argv);
+}
+
+/* Nonzero if begin is NULL or within the token at argv_index of line */
+static int in_token(const Line *const line, const int argv_index,
+                    const char *const begin) {
+    if (!begin)
+        return 1;
+    if (argv_index < 0 || argv_index >= line->argc)
+        return 0;
+    const char *const token = line->argv[argv_index];
+    return begin >= token && begin <= token + strlen(token);
+}
+
+/* Nonzero if every span of the results points into line */
+static int spans_in(const Argparser *const parser, const Line *const line) {
+    int ok = 1;
+    for (size_t i = 0; i < parser->num_opts; ++i) {
+        const char s = parser->opts[i].short_opt;
+        const char *begin = NULL;
+        int argv_index;
+        if (Argparser_str_result(parser, s, NULL, &begin, NULL,
+                                 &argv_index) > 0)
+            ok &= in_token(line, argv_index, begin);
+        for (const ArgparseOccurrence *occ =
+                 Argparser_first_occurrence(parser, s, NULL);
+             occ; occ = Argparser_next_occurrence(parser, occ))
+            ok &= in_token(line, occ->argv_index, occ->begin);
+    }
+    size_t num_items;
+    const ArgparseSpan *const items =
+        Argparser_str_list_result(parser, 'w', NULL, &num_items);
+    int argv_index;
+    Argparser_str_result(parser, 'w', NULL, NULL, NULL, &argv_index);
+    for (size_t i = 0; i < num_items; ++i)
+        ok &= in_token(line, argv_index, items[i].begin);
+    return ok;
+}
+
+/* Parse argv from reset results with the cached parser, check that the
+ * results are those of the uncached one, and return 1 on a hit */
+static int parse(Argparser *const cached, Argparser *const uncached,
+                 const char *const *const argv) {
+    Line line = line_copy(argv);
+    const uint64_t hits = Argparser_stats(cached)->cache_hits;
+    const uint64_t misses = Argparser_stats(cached)->cache_misses;
+    CheckText expected, got;
+
+    Argparser_reset(cached);
+    Argparser_reset(uncached);
+    const int ret = Argparser_parse(cached, line.argc,
+                                    (const char *const *)line.argv);
+    CHECK(ret == Argparser_parse(uncached, line.argc, argv));
+    CHECK(spans_in(cached, &line));
+    check_describe(uncached, &expected);
+    check_describe(cached, &got);
+    CHECK(check_same(&expected, &got));
+
+    const int hit = Argparser_stats(cached)->cache_hits == hits + 1;
+    CHECK(hit + Argparser_stats(cached)->cache_misses - misses == 1);
+    /* Results must not point into the entry or an earlier argv */
+    Argparser_reset(cached);
+    Argparser_reset(uncached);
+    line_free(&line);
+    return hit;
+}
+
+/* Positional arguments need a subcommand, as they would name one */
+static const char *const line_a[] = {"prog", "-n",    "1",   "--num=2",
+                                     "-s",   "hello", "-w",  "x,yz,",
+                                     "run",  "p1",    NULL};
+static const char *const line_b[] = {"prog", "-v",   "--ints=1,2,3", "-f",
+                                     "0.25", "stop", "--",           "-v",
+                                     NULL};
+static const char *const line_c[] = {"prog", "--str=", NULL};
+
+static void check_hits(Argparser *const cached, Argparser *const uncached) {
+    CHECK(!parse(cached, uncached, line_a));
+    CHECK(parse(cached, uncached, line_a));
+    CHECK(parse(cached, uncached, line_a));
+    CHECK(!parse(cached, uncached, line_b));
+    CHECK(parse(cached, uncached, line_b));
+    CHECK(parse(cached, uncached, line_a));
+
+    /* argv[0] is not part of the key */
+    const char *const renamed[] = {"other", "-v",   "--ints=1,2,3", "-f",
+                                   "0.25",  "stop", "--",           "-v",
+                                   NULL};
+    CHECK(parse(cached, uncached, renamed));
+
+    /* Failed parses are not cached */
+    const char *const bad[] = {"prog", "--nope", NULL};
+    CHECK(!parse(cached, uncached, bad));
+    CHECK(!parse(cached, uncached, bad));
+}
+
+static void check_eviction(Argparser *const cached,
+                           Argparser *const uncached) {
+    CHECK(!Argparser_set_cache(cached, 2));
+    CHECK(!parse(cached, uncached, line_a));
+    CHECK(!parse(cached, uncached, line_b));
+    /* a becomes the most recently used, so c evicts b */
+    CHECK(parse(cached, uncached, line_a));
+    CHECK(!parse(cached, uncached, line_c));
+    CHECK(parse(cached, uncached, line_a));
+    CHECK(parse(cached, uncached, line_c));
+    /* Now a is the least recently used */
+    CHECK(!parse(cached, uncached, line_b));
+    CHECK(!parse(cached, uncached, line_a));
+    CHECK(parse(cached, uncached, line_b));
+    CHECK(!parse(cached, uncached, line_c));
+    CHECK(!Argparser_set_cache(cached, 16));
+}
+
+static void check_subcommands(Argparser *const cached,
+                              Argparser *const uncached) {
+    const char *const run[] = {"prog", "-v", "run", "-j", "4", "p", NULL};
+    const char *const run5[] = {"prog", "run", "--jobs=5", NULL};
+    const char *const stop[] = {"prog", "stop", "-k", "-n", "3", NULL};
+    const char *const global[] = {"prog", "-v", NULL};
+
+    CHECK(!parse(cached, uncached, run));
+    CHECK(parse(cached, uncached, run));
+    CHECK(!parse(cached, uncached, stop));
+    CHECK(parse(cached, uncached, run));
+    CHECK(parse(cached, uncached, stop));
+    /* The options of the last subcommand are gone without one */
+    CHECK(!parse(cached, uncached, global));
+    CHECK(parse(cached, uncached, global));
+    CHECK(cached->num_opts == uncached->num_opts);
+    CHECK(!parse(cached, uncached, run5));
+    CHECK(parse(cached, uncached, run));
+    CHECK(parse(cached, uncached, run5));
+}
+
+/* Command lines that hash alike or concatenate alike must not be taken for
+ * each other */
+static void check_lookalikes(Argparser *const cached,
+                             Argparser *const uncached) {
+    const char *const pairs[][5] = {
+        /* Same length, same first and last 8 bytes */
+        {"prog", "--str=abcdefgh-1-ijklmnop", NULL, NULL},
+        {"prog", "--str=abcdefgh-2-ijklmnop", NULL, NULL},
+        {"prog", "--words=aaaaaaaa,b,cccccccc", NULL, NULL},
+        {"prog", "--words=aaaaaaaa,bbcccccccc", NULL, NULL},
+        {"prog", "-s", "0123456789abcdefXYZ0123456789abcdef", NULL},
+        {"prog", "-s", "0123456789abcdefxyz0123456789abcdef", NULL},
+        /* Same bytes, split differently */
+        {"prog", "run", "ab", "c"},
+        {"prog", "run", "a", "bc"},
+    };
+    const size_t num_lines = sizeof pairs / sizeof pairs[0];
+    for (size_t i = 0; i < num_lines; ++i)
+        CHECK(!parse(cached, uncached, pairs[i]));
+    for (size_t i = 0; i < num_lines; ++i)
+        CHECK(parse(cached, uncached, pairs[i]));
+}
+
+int main(void) {
+    Argparser cached, uncached;
+    CHECK(!init_parser(&cached) && !init_parser(&uncached));
+    CHECK(!Argparser_set_cache(&cached, 16));
+
+    check_hits(&cached, &uncached);
+    check_eviction(&cached, &uncached);
+    Argparser_clear_cache(&cached);
+    check_subcommands(&cached, &uncached);
+    Argparser_clear_cache(&cached);
+    check_lookalikes(&cached, &uncached);
+
+    /* Adding an option clears the cache */
+    CHECK(!parse(&cached, &uncached, line_a));
+    CHECK(!Argparser_add_argument(&cached, 'q', "quiet", ARG_BOOL) &&
+          !Argparser_add_argument(&uncached, 'q', "quiet", ARG_BOOL));
+    CHECK(!parse(&cached, &uncached, line_a));
+    CHECK(parse(&cached, &uncached, line_a));
+
+    Argparser_deinit(&cached);
+    Argparser_deinit(&uncached);
+    return CHECK_EXIT();
+}
@@ -0,0 +1,208 @@
+/*##############################################################################
+#                                                                              #
+#                           Copyright 2018 C. P. Tam                           #
+#                                                                              #
+#       The argparse project is covered by the terms of the MIT License.       #
+#       See the file "LICENSE" for details.                                    #
+#                                                                              #
+##############################################################################*/
+
+/*
+ * Helpers shared by the tests. A failed CHECK is reported and the test goes
+ * on; CHECK_EXIT returns the exit status, nonzero if any check failed.
+ */
+
+#ifndef ARGPARSE_CHECK_H
+#define ARGPARSE_CHECK_H
+
+#include "argparse.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static int check_failures;
+
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,   \
+                    #cond);                                                    \
+            ++check_failures;                                                  \
+        }                                                                      \
+    } while (0)
+
+#define CHECK_EXIT() (check_failures != 0)
+
+/* Text of the whole results, for comparing parses */
+typedef struct CheckText {
+    char buf[8192];
+    size_t len;
+} CheckText;
+
+static inline void check_printf(CheckText *const text, const char *const fmt,
+                                ...) {
+    va_list args;
+    va_start(args, fmt);
+    if (text->len < sizeof text->buf) {
+        const int n = vsnprintf(text->buf + text->len,
+                                sizeof text->buf - text->len, fmt, args);
+        if (n > 0)
+            text->len += (size_t)n;
+    }
+    va_end(args);
+}
+
+static inline void check_span(CheckText *const text, const char *const begin,
+                              const size_t len) {
+    if (begin)
+        check_printf(text, "'%.*s'", (int)len, begin);
+    else
+        check_printf(text, "NULL");
+}
+
+/* Name the token at argv_index by its index, or with by_token by its text */
+static inline void check_token(CheckText *const text,
+                               const Argparser *const parser,
+                               const int argv_index, const int by_token) {
+    if (by_token) {
+        const char *const token = Argparser_arg(parser, argv_index);
+        check_printf(text, "'%s'", token ? token : "(none)");
+    } else {
+        check_printf(text, "%d", argv_index);
+    }
+}
+
+static inline void check_describe_as(const Argparser *const parser,
+                                     CheckText *const text,
+                                     const int by_token) {
+    text->len = 0;
+    text->buf[0] = '\0';
+    for (size_t i = 0; i < parser->num_opts; ++i) {
+        const ArgparseOpt *const opt = parser->opts + i;
+        const char s = opt->short_opt;
+        const char *const l = s ? NULL : opt->long_opt;
+        const char *begin = NULL;
+        size_t len = 0;
+        int count, argv_index = 0;
+        check_printf(text, "%c/%s:", s ? s : '-', l ? l : "");
+        switch (opt->type) {
+        case ARG_BOOL:
+            count = Argparser_bool_result(parser, s, l, &begin, &argv_index);
+            len = begin ? strlen(begin) : 0;
+            break;
+        case ARG_STR:
+            count = Argparser_str_result(parser, s, l, &begin, &len,
+                                         &argv_index);
+            break;
+        case ARG_FLOAT:
+            check_printf(text, " %a", Argparser_float_result(
+                                          parser, s, l, &count, &begin, &len,
+                                          &argv_index));
+            break;
+        case ARG_UINT:
+        case ARG_UINT8:
+        case ARG_UINT16:
+        case ARG_UINT32:
+        case ARG_UINT64:
+            check_printf(text, " %ju", Argparser_uint_result(
+                                           parser, s, l, &count, &begin, &len,
+                                           &argv_index));
+            break;
+        case ARG_INT_LIST:
+        case ARG_FLOAT_LIST:
+        case ARG_STR_LIST:
+            /* Items are described below */
+            count = Argparser_str_result(parser, s, l, &begin, &len,
+                                         &argv_index);
+            break;
+        default:
+            check_printf(text, " %jd", Argparser_int_result(
+                                           parser, s, l, &count, &begin, &len,
+                                           &argv_index));
+            break;
+        }
+        check_printf(text, " count %d", count);
+        if (count > 0) {
+            check_printf(text, " at ");
+            check_token(text, parser, argv_index, by_token);
+            check_printf(text, " ");
+            check_span(text, begin, len);
+        }
+        check_printf(text, " conv %d", Argparser_conversion(parser, s, l));
+
+        size_t num_items;
+        if (opt->type == ARG_INT_LIST) {
+            const intmax_t *const items =
+                Argparser_int_list_result(parser, s, l, &num_items);
+            for (size_t j = 0; j < num_items; ++j)
+                check_printf(text, " [%jd]", items[j]);
+        } else if (opt->type == ARG_FLOAT_LIST) {
+            const double *const items =
+                Argparser_float_list_result(parser, s, l, &num_items);
+            for (size_t j = 0; j < num_items; ++j)
+                check_printf(text, " [%a]", items[j]);
+        } else if (opt->type == ARG_STR_LIST) {
+            const ArgparseSpan *const items =
+                Argparser_str_list_result(parser, s, l, &num_items);
+            for (size_t j = 0; j < num_items; ++j) {
+                check_printf(text, " [");
+                check_span(text, items[j].begin, items[j].len);
+                check_printf(text, "]");
+            }
+        }
+
+        for (const ArgparseOccurrence *occ =
+                 Argparser_first_occurrence(parser, s, l);
+             occ; occ = Argparser_next_occurrence(parser, occ)) {
+            check_printf(text, " {");
+            check_token(text, parser, occ->argv_index, by_token);
+            check_printf(text, " ");
+            check_span(text, occ->begin, occ->val_strlen);
+            check_printf(text, " %jd}", occ->int_val);
+        }
+        check_printf(text, "\n");
+    }
+
+    const size_t num_pos_args = Argparser_num_pos_args(parser);
+    for (size_t i = 0; i < num_pos_args; ++i) {
+        int argv_index;
+        Argparser_get_pos_arg(parser, i, &argv_index);
+        check_printf(text, "pos ");
+        check_token(text, parser, argv_index, by_token);
+        check_printf(text, " '%s'\n", Argparser_arg(parser, argv_index));
+    }
+    const ArgparseSubcommand *const subcommand = Argparser_subcommand(parser);
+    if (subcommand)
+        check_printf(text, "subcommand %s\n", subcommand->name);
+    const ArgparseError *const error = Argparser_error(parser);
+    if (error->code != ARG_ERROR_NONE) {
+        check_printf(text, "error %d at ", (int)error->code);
+        check_token(text, parser, error->argv_index, by_token);
+        check_printf(text, "\n");
+    }
+}
+
+/* Describe every option, occurrence, list item and positional argument of
+ * the parser's results, and the error if there is one */
+static inline void check_describe(const Argparser *const parser,
+                                  CheckText *const text) {
+    check_describe_as(parser, text, 0);
+}
+
+/* Like check_describe, naming tokens by their text rather than their argv
+ * index, for comparing parses that number tokens differently */
+static inline void check_describe_tokens(const Argparser *const parser,
+                                         CheckText *const text) {
+    check_describe_as(parser, text, 1);
+}
+
+/* Nonzero if both texts are the same, printing them if not */
+static inline int check_same(const CheckText *const a,
+                             const CheckText *const b) {
+    if (a->len == b->len && memcmp(a->buf, b->buf, a->len) == 0)
+        return 1;
+    fprintf(stderr, "--- expected\n%s--- got\n%s", a->buf, b->buf);
+    return 0;
+}
+
+#endif
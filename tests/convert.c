@@ -0,0 +1,201 @@
+/*##############################################################################
+#                                                                              #
+#                           Copyright 2018 C. P. Tam                           #
+#                                                                              #
+#       The argparse project is covered by the terms of the MIT License.       #
+#       See the file "LICENSE" for details.                                    #
+#                                                                              #
+##############################################################################*/
+
+/*
+ * Number conversion: the fast float path, signs, ranges, overflow and
+ * underflow of floats, and running out of memory while converting.
+ */
+
+#include "check.h"
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+
+static int init_parser(Argparser *const parser,
+                       const ArgparseAllocator *const allocator) {
+    return Argparser_init_allocator(parser, "convert", -1, allocator) ||
+           Argparser_add_argument(parser, 'f', "float", ARG_FLOAT) ||
+           Argparser_add_argument(parser, 'x', "floats", ARG_FLOAT_LIST) ||
+           Argparser_add_argument(parser, 'u', "uint", ARG_UINT) ||
+           Argparser_add_argument_flags(parser, 'h', "hex", ARG_UINT,
+                                        ARG_FLAG_HEX) ||
+           Argparser_add_argument(parser, 'b', "byte", ARG_UINT8) ||
+           Argparser_add_argument(parser, 'i', "int", ARG_INT);
+}
+
+/* Parse "-<opt> <val>" and return the error code, ARG_ERROR_NONE if none */
+static ArgparseErrorCode parse(Argparser *const parser, const char opt,
+                               const char *const val) {
+    const char name[] = {'-', opt, '\0'};
+    const char *const argv[] = {"convert", name, val};
+    Argparser_reset(parser);
+    Argparser_parse(parser, 3, argv);
+    return Argparser_error(parser)->code;
+}
+
+static void check_floats(Argparser *const parser) {
+    static const struct {
+        const char *arg;
+        ArgparseErrorCode code;
+        double val;
+    } cases[] = {
+        /* The fast path must agree with strtod, which handles what it does
+         * not */
+        {"1.5", ARG_ERROR_NONE, 1.5},
+        {"-2.5e-3", ARG_ERROR_NONE, -2.5e-3},
+        {"1e3", ARG_ERROR_NONE, 1e3},
+        {"0x1p3", ARG_ERROR_NONE, 8.0},
+        {"0x10", ARG_ERROR_NONE, 16.0},
+        {"1.5x", ARG_ERROR_INVALID_VALUE, 0},
+        {"1e5q", ARG_ERROR_INVALID_VALUE, 0},
+        {"1e308", ARG_ERROR_NONE, 1e308},
+        {"1e309", ARG_ERROR_OUT_OF_RANGE, 0},
+        {"-1e309", ARG_ERROR_OUT_OF_RANGE, 0},
+        {"0x1p1024", ARG_ERROR_OUT_OF_RANGE, 0},
+        {"inf", ARG_ERROR_NONE, INFINITY},
+        {"-Infinity", ARG_ERROR_NONE, -INFINITY},
+        /* Underflow rounds to a subnormal number or zero */
+        {"4e-320", ARG_ERROR_NONE, 4e-320},
+        {"1e-400", ARG_ERROR_NONE, 0},
+        {"-1e-400", ARG_ERROR_NONE, -0.0},
+        {"1e", ARG_ERROR_INVALID_VALUE, 0},
+        {"", ARG_ERROR_INVALID_VALUE, 0},
+    };
+    for (size_t i = 0; i < sizeof cases / sizeof cases[0]; ++i) {
+        errno = EBADF;
+        const ArgparseErrorCode code = parse(parser, 'f', cases[i].arg);
+        const double val =
+            Argparser_float_result(parser, 'f', NULL, NULL, NULL, NULL, NULL);
+        if (code != cases[i].code || val != cases[i].val ||
+            signbit(val) != signbit(cases[i].val)) {
+            fprintf(stderr, "float '%s': error %d, value %g\n", cases[i].arg,
+                    (int)code, val);
+            CHECK(0);
+        }
+        /* Converting leaves errno alone */
+        CHECK(errno == EBADF);
+    }
+
+    /* An empty list is not a missing one */
+    size_t num_items = 1;
+    CHECK(parse(parser, 'x', "") == ARG_ERROR_NONE);
+    CHECK(Argparser_float_list_result(parser, 'x', NULL, &num_items) &&
+          num_items == 0);
+    CHECK(!Argparser_int_list_result(parser, 'x', NULL, &num_items));
+    CHECK(parse(parser, 'f', "1") == ARG_ERROR_NONE);
+    num_items = 1;
+    CHECK(!Argparser_float_list_result(parser, 'x', NULL, &num_items) &&
+          num_items == 0);
+
+    /* Items are not terminated, so long ones are copied for strtod */
+    CHECK(parse(parser, 'x', "1,1e999") == ARG_ERROR_OUT_OF_RANGE);
+    CHECK(Argparser_error(parser)->len == 5);
+    CHECK(parse(parser, 'x', "1e-999,2") == ARG_ERROR_NONE);
+
+    /* Options not given have no conversion, with or without lazy
+     * conversion */
+    CHECK(parse(parser, 'f', "1") == ARG_ERROR_NONE);
+    CHECK(Argparser_conversion(parser, 'u', NULL) == ARG_CONVERSION_ABSENT);
+    CHECK(Argparser_conversion(parser, 0, "floats") == ARG_CONVERSION_ABSENT);
+    CHECK(Argparser_conversion(parser, 'f', NULL) == ARG_CONVERSION_OK);
+    CHECK(Argparser_conversion(parser, 'q', NULL) == -1);
+
+    /* Lazy conversion tells the same apart */
+    parser->flags |= ARGPARSER_LAZY_CONVERSION;
+    CHECK(Argparser_conversion(parser, 'u', NULL) == ARG_CONVERSION_ABSENT);
+    CHECK(parse(parser, 'x', "1,1e999") == ARG_ERROR_OUT_OF_RANGE);
+    CHECK(parse(parser, 'f', "1e309") == ARG_ERROR_NONE);
+    CHECK(Argparser_convert_index(parser, 0) == ARG_CONVERSION_OUT_OF_RANGE);
+    CHECK(Argparser_conversion(parser, 'f', NULL) ==
+          ARG_CONVERSION_OUT_OF_RANGE);
+    CHECK(Argparser_convert_index(parser, 2) == ARG_CONVERSION_ABSENT);
+    CHECK(Argparser_convert_index(parser, parser->num_opts) == -1);
+    CHECK(parse(parser, 'f', "1e-400") == ARG_ERROR_NONE);
+    CHECK(Argparser_conversion(parser, 'f', NULL) == ARG_CONVERSION_OK);
+    CHECK(parse(parser, 'f', "1e3x") == ARG_ERROR_NONE);
+    CHECK(Argparser_conversion(parser, 'f', NULL) == ARG_CONVERSION_INVALID);
+    parser->flags &= ~(unsigned)ARGPARSER_LAZY_CONVERSION;
+}
+
+static void check_signs(Argparser *const parser) {
+    uintmax_t u;
+    CHECK(parse(parser, 'u', "+5") == ARG_ERROR_NONE);
+    u = Argparser_uint_result(parser, 'u', NULL, NULL, NULL, NULL, NULL);
+    CHECK(u == 5);
+    CHECK(parse(parser, 'h', "+0x10") == ARG_ERROR_NONE);
+    u = Argparser_uint_result(parser, 'h', NULL, NULL, NULL, NULL, NULL);
+    CHECK(u == 16);
+    CHECK(parse(parser, 'b', "+255") == ARG_ERROR_NONE);
+    CHECK(parse(parser, 'b', "+256") == ARG_ERROR_OUT_OF_RANGE);
+    CHECK(parse(parser, 'u', "18446744073709551615") == ARG_ERROR_NONE);
+    CHECK(parse(parser, 'u', "+18446744073709551616") ==
+          ARG_ERROR_OUT_OF_RANGE);
+
+    /* One plus sign, and no minus sign */
+    CHECK(parse(parser, 'u', "-5") == ARG_ERROR_INVALID_VALUE);
+    CHECK(parse(parser, 'u', "-0") == ARG_ERROR_INVALID_VALUE);
+    CHECK(parse(parser, 'u', "++5") == ARG_ERROR_INVALID_VALUE);
+    CHECK(parse(parser, 'u', "+") == ARG_ERROR_INVALID_VALUE);
+    CHECK(parse(parser, 'u', "+-5") == ARG_ERROR_INVALID_VALUE);
+    CHECK(parse(parser, 'i', "+-5") == ARG_ERROR_INVALID_VALUE);
+    CHECK(parse(parser, 'i', "-+5") == ARG_ERROR_INVALID_VALUE);
+    CHECK(parse(parser, 'i', "+5") == ARG_ERROR_NONE);
+}
+
+/* Allocator failing every request of fail_size bytes */
+static size_t fail_size;
+
+static void *failing_reallocate(void *const ctx, void *const ptr,
+                                const size_t old_size, const size_t new_size) {
+    (void)ctx;
+    (void)old_size;
+    return new_size == fail_size ? NULL : realloc(ptr, new_size);
+}
+
+static void failing_release(void *const ctx, void *const ptr) {
+    (void)ctx;
+    free(ptr);
+}
+
+/* Out of memory is told apart from a malformed number */
+static void check_no_memory(void) {
+    const ArgparseAllocator allocator = {failing_reallocate, failing_release,
+                                         NULL};
+    Argparser parser;
+    CHECK(!init_parser(&parser, &allocator));
+
+    /* 1e-198, too long for the buffer on the stack */
+    char item[256] = "0.";
+    memset(item + 2, '0', 197);
+    strcpy(item + 199, "1,2");
+    const size_t len = strlen(item) - 2;
+    CHECK(parse(&parser, 'x', item) == ARG_ERROR_NONE);
+    size_t num_items;
+    const double *const items =
+        Argparser_float_list_result(&parser, 'x', NULL, &num_items);
+    CHECK(num_items == 2 && items[0] == 1e-198 && items[1] == 2);
+
+    fail_size = len + 1;
+    CHECK(parse(&parser, 'x', item) == ARG_ERROR_ALLOCATION);
+    item[len - 1] = 'x';
+    CHECK(parse(&parser, 'x', item) == ARG_ERROR_ALLOCATION);
+    fail_size = 0;
+    CHECK(parse(&parser, 'x', item) == ARG_ERROR_INVALID_VALUE);
+    Argparser_deinit(&parser);
+}
+
+int main(void) {
+    Argparser parser;
+    CHECK(!init_parser(&parser, NULL));
+    check_floats(&parser);
+    check_signs(&parser);
+    Argparser_deinit(&parser);
+    check_no_memory();
+    return CHECK_EXIT();
+}
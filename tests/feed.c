@@ -0,0 +1,169 @@
+/*##############################################################################
+#                                                                              #
+#                           Copyright 2018 C. P. Tam                           #
+#                                                                              #
+#       The argparse project is covered by the terms of the MIT License.       #
+#       See the file "LICENSE" for details.                                    #
+#                                                                              #
+##############################################################################*/
+
+/*
+ * Incremental parsing: a command line fed in chunks split anywhere, even
+ * inside "--name=value", quotes and escapes, gives the results of parsing it
+ * in one go.
+ */
+
+#include "check.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Quotes and backslashes are literal in fed tokens, and only mean something
+ * in response files */
+static const char response_file[] =
+    "-n 3 \"--str=quoted \\\"inner\\\" text\"\n"
+    "'--words=single \\q,x' esc\\ aped\t--ints=\"4,\"5\n";
+
+static int init_parser(Argparser *const parser) {
+    if (Argparser_init(parser, "feed", -1) ||
+        Argparser_add_argument_flags(parser, 'n', "num", ARG_INT,
+                                     ARG_FLAG_ACCUMULATE) ||
+        Argparser_add_argument(parser, 'f', "float", ARG_FLOAT) ||
+        Argparser_add_argument(parser, 's', "str", ARG_STR) ||
+        Argparser_add_argument(parser, 'v', "verbose", ARG_BOOL) ||
+        Argparser_add_argument(parser, 'l', "ints", ARG_INT_LIST) ||
+        Argparser_add_argument(parser, 'w', "words", ARG_STR_LIST))
+        return 1;
+    parser->flags |= ARGPARSER_RESPONSE_FILES;
+    return 0;
+}
+
+/* The tokens after argv[0], each '\0'-terminated, in one buffer */
+static size_t join(const char *const *const tokens, char *const buf) {
+    size_t len = 0;
+    for (size_t i = 0; tokens[i]; ++i) {
+        strcpy(buf + len, tokens[i]);
+        len += strlen(tokens[i]) + 1;
+    }
+    return len;
+}
+
+/* Feed buf in chunks ending at the given offsets, the last at len, then
+ * finish, stopping at the first failure */
+static int feed(Argparser *const parser, const char *const buf,
+                const size_t *const ends, const size_t num_ends) {
+    size_t begin = 0;
+    for (size_t i = 0; i < num_ends; ++i) {
+        if (Argparser_feed_buffer(parser, buf + begin, ends[i] - begin))
+            return 1;
+        begin = ends[i];
+    }
+    return Argparser_finish(parser);
+}
+
+static void check_line(const char *const *const argv) {
+    Argparser expected_parser, parser;
+    CheckText expected, got;
+    CHECK(!init_parser(&expected_parser) && !init_parser(&parser));
+    int argc = 0;
+    while (argv[argc])
+        ++argc;
+    const int ret = Argparser_parse(&expected_parser, argc, argv);
+    check_describe_tokens(&expected_parser, &expected);
+
+    char buf[1024];
+    const size_t len = join(argv + 1, buf);
+    size_t failures = 0;
+
+    /* Every split into two and three chunks, including empty ones */
+    for (size_t i = 0; i <= len; ++i) {
+        for (size_t j = i; j <= len; ++j) {
+            const size_t ends[] = {i, j, len};
+            Argparser_reset(&parser);
+            const int feed_ret = feed(&parser, buf, ends, 3);
+            check_describe_tokens(&parser, &got);
+            if (feed_ret != ret || !check_same(&expected, &got)) {
+                fprintf(stderr, "split at %zu and %zu\n", i, j);
+                if (++failures > 3)
+                    goto check_line_exit;
+            }
+        }
+    }
+
+    /* One byte at a time */
+    size_t ends[sizeof buf];
+    for (size_t i = 0; i < len; ++i)
+        ends[i] = i + 1;
+    Argparser_reset(&parser);
+    CHECK(feed(&parser, buf, ends, len) == ret);
+    check_describe_tokens(&parser, &got);
+    CHECK(check_same(&expected, &got));
+
+    /* The last token need not be terminated */
+    for (size_t i = 0; i < len; ++i) {
+        const size_t unterminated[] = {i, len - 1};
+        Argparser_reset(&parser);
+        CHECK(feed(&parser, buf, unterminated, 2) == ret);
+        check_describe_tokens(&parser, &got);
+        CHECK(check_same(&expected, &got));
+    }
+
+    /* Token by token */
+    Argparser_reset(&parser);
+    int feed_ret = 0;
+    for (int i = 1; i < argc && !feed_ret; ++i)
+        feed_ret = Argparser_feed(&parser, argv[i]);
+    if (!feed_ret)
+        feed_ret = Argparser_finish(&parser);
+    CHECK(feed_ret == ret);
+    check_describe_tokens(&parser, &got);
+    CHECK(check_same(&expected, &got));
+
+check_line_exit:
+    CHECK(failures == 0);
+    Argparser_deinit(&expected_parser);
+    Argparser_deinit(&parser);
+}
+
+int main(void) {
+    char path[] = "/tmp/argparse-feed-XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0 && write(fd, response_file, sizeof response_file - 1) ==
+                         (ssize_t)(sizeof response_file - 1));
+    close(fd);
+    char at_path[sizeof path + 1] = "@";
+    strcat(at_path, path);
+
+    const char *const full[] = {"feed",
+                                "-n",
+                                "1",
+                                "--num=2",
+                                "-vs",
+                                "x=y",
+                                "--ints",
+                                "-1,22,333",
+                                "--float=0x1p-3",
+                                at_path,
+                                "--str=a\"b c\\\"d'",
+                                "--words=a,\"b\",c\\,d,",
+                                "=",
+                                "",
+                                "-v",
+                                "--",
+                                "-v",
+                                "--str=",
+                                NULL};
+    const char *const options_only[] = {"feed", "--str==", "-f", "2.5",
+                                        "--verbose", NULL};
+    const char *const bad_value[] = {"feed", "-n", "4", "--num=12x", "-v",
+                                     NULL};
+    const char *const missing_value[] = {"feed", "-v", "--str", NULL};
+    const char *const unknown[] = {"feed", "--verb=1", "-v", NULL};
+
+    check_line(full);
+    check_line(options_only);
+    check_line(bad_value);
+    check_line(missing_value);
+    check_line(unknown);
+    unlink(path);
+    return CHECK_EXIT();
+}
@@ -0,0 +1,229 @@
+/*##############################################################################
+#                                                                              #
+#                           Copyright 2018 C. P. Tam                           #
+#                                                                              #
+#       The argparse project is covered by the terms of the MIT License.       #
+#       See the file "LICENSE" for details.                                    #
+#                                                                              #
+##############################################################################*/
+
+/*
+ * Response files, read from tests/fixtures: quoting, nesting up to
+ * ARGPARSER_MAX_RESPONSE_DEPTH, "--", files that cannot be read, and the argv
+ * indices given to their tokens.
+ */
+
+#include "check.h"
+#include <errno.h>
+#include <unistd.h>
+
+static int init_parser(Argparser *const parser) {
+    if (Argparser_init(parser, "response", -1) ||
+        Argparser_add_argument_flags(parser, 'n', "num", ARG_INT,
+                                     ARG_FLAG_ACCUMULATE) ||
+        Argparser_add_argument(parser, 's', "str", ARG_STR) ||
+        Argparser_add_argument(parser, 'v', "verbose", ARG_BOOL) ||
+        Argparser_add_argument(parser, 'w', "words", ARG_STR_LIST))
+        return 1;
+    parser->flags |= ARGPARSER_RESPONSE_FILES;
+    return 0;
+}
+
+static int parse(Argparser *const parser, const char *const *const argv) {
+    int argc = 0;
+    while (argv[argc])
+        ++argc;
+    Argparser_reset(parser);
+    return Argparser_parse(parser, argc, argv);
+}
+
+/* Nonzero if the tokens from argv index first on are those of tokens, and
+ * there are no more */
+static int tokens_are(const Argparser *const parser, const int first,
+                      const char *const *const tokens) {
+    int i = 0;
+    for (; tokens[i]; ++i) {
+        const char *const token = Argparser_arg(parser, first + i);
+        if (!token || strcmp(token, tokens[i]) != 0) {
+            fprintf(stderr, "token %d is '%s', not '%s'\n", first + i,
+                    token ? token : "(none)", tokens[i]);
+            return 0;
+        }
+    }
+    return !Argparser_arg(parser, first + i);
+}
+
+/* Nonzero if the positional arguments are those of expected */
+static int pos_args_are(const Argparser *const parser,
+                        const char *const *const expected) {
+    size_t i = 0;
+    for (; expected[i]; ++i) {
+        int argv_index;
+        if (Argparser_get_pos_arg(parser, i, &argv_index) ||
+            strcmp(Argparser_arg(parser, argv_index), expected[i]) != 0)
+            return 0;
+    }
+    return Argparser_num_pos_args(parser) == i;
+}
+
+/* Nonzero if the last parse failed with code at argv_index, naming path */
+static int failed_with(const Argparser *const parser,
+                       const ArgparseErrorCode code, const int argv_index,
+                       const char *const path) {
+    const ArgparseError *const error = Argparser_error(parser);
+    return error->code == code && error->argv_index == argv_index &&
+           error->len == strlen(path) &&
+           memcmp(error->begin, path, error->len) == 0;
+}
+
+static void check_quoting(Argparser *const parser) {
+    const char *const argv[] = {"prog", "@quoting.rsp", NULL};
+    const char *const tokens[] = {"-n",
+                                  "1",
+                                  "--str=double \"quoted\" value",
+                                  "single \\ kept",
+                                  "back slash",
+                                  "--words=a b,c d,e",
+                                  "-v",
+                                  NULL};
+    const char *const pos_args[] = {"single \\ kept", "back slash", NULL};
+    CHECK(!parse(parser, argv));
+    CHECK(tokens_are(parser, 2, tokens));
+    CHECK(pos_args_are(parser, pos_args));
+
+    const char *begin;
+    size_t len, num_items;
+    int argv_index;
+    CHECK(Argparser_str_result(parser, 's', NULL, &begin, &len,
+                               &argv_index) == 1);
+    CHECK(argv_index == 4 && len == strlen("double \"quoted\" value") &&
+          memcmp(begin, "double \"quoted\" value", len) == 0);
+    const ArgparseSpan *const words =
+        Argparser_str_list_result(parser, 'w', NULL, &num_items);
+    CHECK(num_items == 3 && words[0].len == 3 && words[1].len == 3 &&
+          words[2].len == 1 && memcmp(words[0].begin, "a b", 3) == 0 &&
+          memcmp(words[1].begin, "c d", 3) == 0 && words[2].begin[0] == 'e');
+    CHECK(Argparser_bool_result(parser, 'v', NULL, NULL, &argv_index) == 1 &&
+          argv_index == 8);
+
+    /* Line ends and the end of the file end tokens too */
+    const char *const crlf[] = {"prog", "@crlf.rsp", NULL};
+    const char *const crlf_tokens[] = {"-v", "-n", "5", NULL};
+    CHECK(!parse(parser, crlf));
+    CHECK(tokens_are(parser, 2, crlf_tokens));
+
+    const char *const empty[] = {"prog", "@empty.rsp", "-v", NULL};
+    const char *const no_tokens[] = {NULL};
+    CHECK(!parse(parser, empty));
+    CHECK(tokens_are(parser, 3, no_tokens));
+    CHECK(Argparser_bool_result(parser, 'v', NULL, NULL, &argv_index) == 1 &&
+          argv_index == 2);
+
+    const char *const unterminated[] = {"prog", "@unterminated.rsp", NULL};
+    CHECK(parse(parser, unterminated));
+    CHECK(failed_with(parser, ARG_ERROR_UNTERMINATED_QUOTE, 1,
+                      "unterminated.rsp"));
+}
+
+static void check_nesting(Argparser *const parser) {
+    /* Tokens are numbered from argc on, in the order they are expanded */
+    const char *const argv[] = {"prog", "-v", "@outer.rsp", "x", NULL};
+    const char *const tokens[] = {"-n", "2",           "@inner.rsp", "-n",
+                                  "3",  "--str=inner", "-n",         "4",
+                                  NULL};
+    const char *const pos_args[] = {"x", NULL};
+    const uint64_t files = Argparser_stats(parser)->response_files;
+    CHECK(!parse(parser, argv));
+    CHECK(tokens_are(parser, 4, tokens));
+    CHECK(pos_args_are(parser, pos_args));
+
+    const int expected_indices[] = {5, 8, 11};
+    size_t i = 0;
+    for (const ArgparseOccurrence *occ =
+             Argparser_first_occurrence(parser, 'n', NULL);
+         occ; occ = Argparser_next_occurrence(parser, occ), ++i)
+        CHECK(i < 3 && occ->argv_index == expected_indices[i] &&
+              occ->int_val == (intmax_t)i + 2);
+    CHECK(i == 3);
+    int argv_index;
+    CHECK(Argparser_str_result(parser, 's', NULL, NULL, NULL,
+                               &argv_index) == 1 &&
+          argv_index == 9);
+    CHECK(Argparser_stats(parser)->response_files == files + 2);
+
+    /* A file including itself stops at the depth limit, at the token of the
+     * file that would be one too deep */
+    const char *const deep[] = {"prog", "@deep.rsp", NULL};
+    int count;
+    CHECK(parse(parser, deep));
+    Argparser_int_result(parser, 'n', NULL, &count, NULL, NULL, NULL);
+    CHECK(count == ARGPARSER_MAX_RESPONSE_DEPTH);
+    const int too_deep = 2 + 3 * (ARGPARSER_MAX_RESPONSE_DEPTH - 1) + 2;
+    CHECK(failed_with(parser, ARG_ERROR_NESTED_TOO_DEEPLY, too_deep,
+                      "deep.rsp"));
+    CHECK(strcmp(Argparser_arg(parser, too_deep), "@deep.rsp") == 0);
+}
+
+static void check_dash_dash(Argparser *const parser) {
+    /* "--" in a file holds for the rest of the command line */
+    const char *const argv[] = {"prog", "@dashdash.rsp", "@quoting.rsp",
+                                NULL};
+    const char *const pos_args[] = {"-n", "@quoting.rsp", "@quoting.rsp",
+                                    NULL};
+    const uint64_t files = Argparser_stats(parser)->response_files;
+    int count;
+    CHECK(!parse(parser, argv));
+    CHECK(pos_args_are(parser, pos_args));
+    CHECK(Argparser_bool_result(parser, 'v', NULL, NULL, NULL) == 1);
+    Argparser_int_result(parser, 'n', NULL, &count, NULL, NULL, NULL);
+    CHECK(count == 0);
+
+    const char *const after[] = {"prog", "--", "@quoting.rsp", NULL};
+    const char *const after_pos_args[] = {"@quoting.rsp", NULL};
+    CHECK(!parse(parser, after));
+    CHECK(pos_args_are(parser, after_pos_args));
+    CHECK(Argparser_stats(parser)->response_files == files + 1);
+}
+
+static void check_unreadable(Argparser *const parser) {
+    const char *const missing[] = {"prog", "-v", "@missing.rsp", NULL};
+    CHECK(parse(parser, missing));
+    CHECK(failed_with(parser, ARG_ERROR_RESPONSE_FILE, 2, "missing.rsp"));
+    CHECK(Argparser_error(parser)->sys_errno == ENOENT);
+
+    const char *const nested[] = {"prog", "@nested-missing.rsp", NULL};
+    CHECK(parse(parser, nested));
+    CHECK(failed_with(parser, ARG_ERROR_RESPONSE_FILE, 3, "missing.rsp"));
+    CHECK(Argparser_bool_result(parser, 'v', NULL, NULL, NULL) == 1);
+
+    const char *const directory[] = {"prog", "@.", NULL};
+    CHECK(parse(parser, directory));
+    CHECK(failed_with(parser, ARG_ERROR_NOT_REGULAR_FILE, 1, "."));
+
+    const char *const device[] = {"prog", "@/dev/null", NULL};
+    CHECK(parse(parser, device));
+    CHECK(failed_with(parser, ARG_ERROR_NOT_REGULAR_FILE, 1, "/dev/null"));
+}
+
+int main(void) {
+    if (chdir("tests/fixtures")) {
+        perror("response: run from the top directory");
+        return 1;
+    }
+    Argparser parser;
+    CHECK(!init_parser(&parser));
+    check_quoting(&parser);
+    check_nesting(&parser);
+    check_dash_dash(&parser);
+    check_unreadable(&parser);
+
+    /* Without the flag, "@path" is an ordinary token */
+    const char *const argv[] = {"prog", "@quoting.rsp", NULL};
+    const char *const pos_args[] = {"@quoting.rsp", NULL};
+    parser.flags &= ~(unsigned)ARGPARSER_RESPONSE_FILES;
+    CHECK(!parse(&parser, argv));
+    CHECK(pos_args_are(&parser, pos_args));
+
+    Argparser_deinit(&parser);
+    return CHECK_EXIT();
+}
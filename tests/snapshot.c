@@ -0,0 +1,204 @@
+/*##############################################################################
+#                                                                              #
+#                           Copyright 2018 C. P. Tam                           #
+#                                                                              #
+#       The argparse project is covered by the terms of the MIT License.       #
+#       See the file "LICENSE" for details.                                    #
+#                                                                              #
+##############################################################################*/
+
+/*
+ * Snapshots: a loaded snapshot gives the results of the parse that wrote it,
+ * and truncated, corrupted or looping blobs are rejected.
+ */
+
+#include "check.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Mirror the blob layout in argparse.c */
+#define HEADER_SIZE 64
+#define SIZE_OFFSET 8
+#define NUM_STATES_OFFSET 24
+#define NUM_OCCURRENCES_OFFSET 32
+#define STATE_SIZE 72
+#define OCCURRENCE_SIZE 40
+#define OCCURRENCE_NEXT_OFFSET 16
+
+/* Last byte of the record fields that no valid snapshot has the top bit of:
+ * opt_index, begin, val_strlen, first_occurrence, last_occurrence,
+ * num_items, count, argv_index and conversion of states, and begin,
+ * val_strlen, next and argv_index of occurrences */
+static const size_t state_fields[] = {7, 15, 23, 31, 39, 47, 51, 55, 59};
+static const size_t occurrence_fields[] = {7, 15, 23, 27};
+
+static int add_jobs(Argparser *const parser, void *const data) {
+    (void)data;
+    return Argparser_add_argument(parser, 'j', "jobs", ARG_UINT);
+}
+
+static int init_parser(Argparser *const parser) {
+    return Argparser_init(parser, "snapshot", -1) ||
+           Argparser_add_argument_flags(parser, 'n', "num", ARG_INT,
+                                        ARG_FLAG_ACCUMULATE) ||
+           Argparser_add_argument(parser, 'f', "float", ARG_FLOAT) ||
+           Argparser_add_argument(parser, 's', "str", ARG_STR) ||
+           Argparser_add_argument(parser, 'v', "verbose", ARG_BOOL) ||
+           Argparser_add_argument(parser, 'l', "ints", ARG_INT_LIST) ||
+           Argparser_add_argument_flags(parser, 'w', "words", ARG_STR_LIST,
+                                        ARG_FLAG_DELIMITER(':')) ||
+           Argparser_add_argument(parser, 'x', "floats", ARG_FLOAT_LIST) ||
+           Argparser_add_subcommand(parser, "run", add_jobs, NULL);
+}
+
+static uint64_t get_u64(const char *const blob, const size_t offset) {
+    uint64_t value;
+    memcpy(&value, blob + offset, sizeof value);
+    return value;
+}
+
+static void put_u64(char *const blob, const size_t offset,
+                    const uint64_t value) {
+    memcpy(blob + offset, &value, sizeof value);
+}
+
+static int loads(Argparser *const parser, const char *const blob,
+                 const size_t size) {
+    /* A copy of exactly size bytes, so that reading past it is caught */
+    char *const copy = malloc(size ? size : 1);
+    memcpy(copy, blob, size);
+    const int ok = !Argparser_load_snapshot(parser, copy, size);
+    Argparser_reset(parser);
+    free(copy);
+    return ok;
+}
+
+static void check_round_trip(const int argc, const char *const *const argv) {
+    Argparser parser, loader;
+    CheckText expected, got;
+    CHECK(!init_parser(&parser) && !init_parser(&loader));
+    CHECK(!Argparser_parse(&parser, argc, argv));
+    check_describe(&parser, &expected);
+
+    const size_t size = Argparser_snapshot_size(&parser);
+    char *const blob = malloc(size);
+    CHECK(Argparser_snapshot(&parser, blob, size - 1));
+    CHECK(!Argparser_snapshot(&parser, blob, size));
+    Argparser_deinit(&parser);
+
+    CHECK(!Argparser_load_snapshot(&loader, blob, size));
+    check_describe(&loader, &got);
+    CHECK(check_same(&expected, &got));
+
+    /* Loading again replaces the results rather than adding to them */
+    CHECK(!Argparser_load_snapshot(&loader, blob, size));
+    check_describe(&loader, &got);
+    CHECK(check_same(&expected, &got));
+    Argparser_deinit(&loader);
+    free(blob);
+}
+
+static void check_corrupt(const int argc, const char *const *const argv) {
+    Argparser parser;
+    CHECK(!init_parser(&parser));
+    CHECK(!Argparser_parse(&parser, argc, argv));
+    const size_t size = Argparser_snapshot_size(&parser);
+    char *const blob = malloc(size);
+    CHECK(!Argparser_snapshot(&parser, blob, size));
+    CHECK(loads(&parser, blob, size));
+
+    /* Truncated, as is and with the size in the header patched to match */
+    for (size_t len = 0; len < size; ++len) {
+        CHECK(!loads(&parser, blob, len));
+        if (len >= HEADER_SIZE) {
+            put_u64(blob, SIZE_OFFSET, len);
+            CHECK(!loads(&parser, blob, len));
+            put_u64(blob, SIZE_OFFSET, size);
+        }
+    }
+
+    /* Wrong magic, including that of the previous format */
+    for (size_t i = 0; i < 4; ++i) {
+        blob[i] ^= 0x20;
+        CHECK(!loads(&parser, blob, size));
+        blob[i] ^= 0x20;
+    }
+    memcpy(blob, "APS1", 4);
+    CHECK(!loads(&parser, blob, size));
+    memcpy(blob, "APS2", 4);
+
+    /* Every bit of the header */
+    for (size_t bit = 0; bit < 8 * HEADER_SIZE; ++bit) {
+        blob[bit / 8] ^= (char)(1 << bit % 8);
+        CHECK(!loads(&parser, blob, size));
+        blob[bit / 8] ^= (char)(1 << bit % 8);
+    }
+
+    /* The top bit of every index, offset, length and count in the records.
+     * Other bits may give another valid snapshot. */
+    const uint64_t num_states = get_u64(blob, NUM_STATES_OFFSET);
+    const uint64_t num_occurrences = get_u64(blob, NUM_OCCURRENCES_OFFSET);
+    const size_t occurrences = HEADER_SIZE + num_states * STATE_SIZE;
+    for (size_t i = 0; i < num_states; ++i) {
+        char *const rec = blob + HEADER_SIZE + i * STATE_SIZE;
+        for (size_t j = 0; j < sizeof state_fields / sizeof *state_fields;
+             ++j) {
+            rec[state_fields[j]] ^= (char)0x80;
+            CHECK(!loads(&parser, blob, size));
+            rec[state_fields[j]] ^= (char)0x80;
+        }
+    }
+    for (size_t i = 0; i < num_occurrences; ++i) {
+        char *const rec = blob + occurrences + i * OCCURRENCE_SIZE;
+        for (size_t j = 0;
+             j < sizeof occurrence_fields / sizeof *occurrence_fields; ++j) {
+            rec[occurrence_fields[j]] ^= (char)0x80;
+            CHECK(!loads(&parser, blob, size));
+            rec[occurrence_fields[j]] ^= (char)0x80;
+        }
+    }
+
+    /* Any bit of the records and strings may be flipped without reading out
+     * of bounds, which the sanitizers catch */
+    for (size_t bit = 8 * HEADER_SIZE; bit < 8 * size; ++bit) {
+        blob[bit / 8] ^= (char)(1 << bit % 8);
+        loads(&parser, blob, size);
+        blob[bit / 8] ^= (char)(1 << bit % 8);
+    }
+
+    /* Occurrence chains that loop back, to themselves or an earlier one */
+    CHECK(num_occurrences >= 2);
+    for (size_t i = 0; i < num_occurrences; ++i) {
+        const size_t at = occurrences + i * OCCURRENCE_SIZE +
+                          OCCURRENCE_NEXT_OFFSET;
+        const uint64_t next = get_u64(blob, at);
+        for (uint64_t target = 1; target <= i + 1; ++target) {
+            put_u64(blob, at, target);
+            CHECK(!loads(&parser, blob, size));
+        }
+        put_u64(blob, at, next);
+    }
+    CHECK(loads(&parser, blob, size));
+
+    Argparser_deinit(&parser);
+    free(blob);
+}
+
+int main(void) {
+    const char *const argv[] = {
+        "prog", "-n",  "1",    "--num=2", "-f",        "2.5",
+        "-s",   "hi",  "-v",   "-v",      "--ints",    "1,-2,3",
+        "-w",   "a::bc:", "-x", "0.5,1e3", "run", "-j", "4", "p1", "-n", "3",
+        "p2",   "--",  "-v"};
+    const int argc = sizeof argv / sizeof argv[0];
+    const char *const plain[] = {"prog", "-v", "--ints=", "-n", "7", "-n",
+                                 "8"};
+    const int plain_argc = sizeof plain / sizeof plain[0];
+    const char *const empty[] = {"prog"};
+
+    check_round_trip(argc, argv);
+    check_round_trip(plain_argc, plain);
+    check_round_trip(1, empty);
+    check_corrupt(argc, argv);
+    return CHECK_EXIT();
+}
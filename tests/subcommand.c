@@ -0,0 +1,143 @@
+/*##############################################################################
+#                                                                              #
+#                           Copyright 2018 C. P. Tam                           #
+#                                                                              #
+#       The argparse project is covered by the terms of the MIT License.       #
+#       See the file "LICENSE" for details.                                    #
+#                                                                              #
+##############################################################################*/
+
+/*
+ * Subcommands: the options of the last one are kept across resets, cache
+ * hits and snapshot loads, so its init only runs again after another
+ * subcommand was selected, and they are never seen without it.
+ */
+
+#include "check.h"
+#include <stdlib.h>
+
+#define NUM_FILLERS 16
+
+static int run_inits, stop_inits, bad_inits;
+
+/* Enough options for a lookup index over them */
+static int add_run(Argparser *const parser, void *const data) {
+    static char names[NUM_FILLERS][8];
+    (void)data;
+    ++run_inits;
+    if (Argparser_add_argument(parser, 'j', "jobs", ARG_UINT))
+        return 1;
+    for (int i = 0; i < NUM_FILLERS; ++i) {
+        snprintf(names[i], sizeof names[i], "fill%d", i);
+        if (Argparser_add_argument(parser, 0, names[i], ARG_INT))
+            return 1;
+    }
+    return 0;
+}
+
+static int add_stop(Argparser *const parser, void *const data) {
+    (void)data;
+    ++stop_inits;
+    return Argparser_add_argument(parser, 'k', "kill", ARG_BOOL);
+}
+
+static int add_bad(Argparser *const parser, void *const data) {
+    (void)data;
+    ++bad_inits;
+    return Argparser_add_argument(parser, 'b', "bad", ARG_BOOL) || 1;
+}
+
+/* Parse a NULL-terminated argv and return the error code */
+static ArgparseErrorCode parse(Argparser *const parser,
+                               const char *const *const argv) {
+    int argc = 0;
+    while (argv[argc])
+        ++argc;
+    Argparser_reset(parser);
+    Argparser_parse(parser, argc, argv);
+    return Argparser_error(parser)->code;
+}
+
+static uintmax_t jobs(const Argparser *const parser) {
+    return Argparser_uint_result(parser, 'j', NULL, NULL, NULL, NULL, NULL);
+}
+
+int main(void) {
+    Argparser parser;
+    CHECK(!Argparser_init(&parser, "sub", -1) &&
+          !Argparser_add_argument(&parser, 'v', "verbose", ARG_BOOL) &&
+          !Argparser_add_argument(&parser, 0, "level", ARG_INT) &&
+          !Argparser_add_subcommand(&parser, "run", add_run, NULL) &&
+          !Argparser_add_subcommand(&parser, "stop", add_stop, NULL) &&
+          !Argparser_add_subcommand(&parser, "bad", add_bad, NULL));
+    const size_t num_global_opts = parser.num_opts;
+
+    const char *const run4[] = {"sub", "-v", "run", "-j", "4", NULL};
+    const char *const run5[] = {"sub", "run", "--fill7=3", "-j5", NULL};
+    CHECK(parse(&parser, run4) == ARG_ERROR_NONE && jobs(&parser) == 4);
+    CHECK(parse(&parser, run5) == ARG_ERROR_NONE && jobs(&parser) == 5);
+    CHECK(Argparser_int_result(&parser, 0, "fill7", NULL, NULL, NULL, NULL) ==
+          3);
+    CHECK(run_inits == 1);
+
+    /* Kept options are not seen without their subcommand */
+    const char *const early[] = {"sub", "-j", "1", "run", NULL};
+    const char *const none[] = {"sub", "--fill1=1", NULL};
+    CHECK(parse(&parser, early) == ARG_ERROR_UNKNOWN_OPTION);
+    CHECK(parse(&parser, none) == ARG_ERROR_UNKNOWN_OPTION);
+    CHECK(parser.num_opts == num_global_opts);
+    CHECK(parse(&parser, run4) == ARG_ERROR_NONE && jobs(&parser) == 4);
+    CHECK(run_inits == 1);
+
+    /* Another subcommand replaces them */
+    const char *const stop[] = {"sub", "stop", "-k", NULL};
+    const char *const stop_jobs[] = {"sub", "stop", "-j", "1", NULL};
+    CHECK(parse(&parser, stop) == ARG_ERROR_NONE);
+    CHECK(parse(&parser, stop_jobs) == ARG_ERROR_UNKNOWN_OPTION);
+    CHECK(stop_inits == 1);
+    CHECK(parse(&parser, run4) == ARG_ERROR_NONE && jobs(&parser) == 4);
+    CHECK(run_inits == 2);
+
+    /* Cache hits select the subcommand too */
+    CHECK(!Argparser_set_cache(&parser, 4));
+    CHECK(parse(&parser, run5) == ARG_ERROR_NONE);
+    CHECK(parse(&parser, run5) == ARG_ERROR_NONE && jobs(&parser) == 5);
+    CHECK(Argparser_stats(&parser)->cache_hits == 1);
+    CHECK(parse(&parser, stop) == ARG_ERROR_NONE);
+    CHECK(parse(&parser, run5) == ARG_ERROR_NONE && jobs(&parser) == 5);
+    CHECK(Argparser_stats(&parser)->cache_hits == 2);
+    CHECK(run_inits == 3 && stop_inits == 2);
+    Argparser_set_cache(&parser, 0);
+
+    /* And so do snapshot loads */
+    CHECK(parse(&parser, run4) == ARG_ERROR_NONE);
+    const size_t size = Argparser_snapshot_size(&parser);
+    void *const blob = malloc(size);
+    CHECK(blob && !Argparser_snapshot(&parser, blob, size));
+    CHECK(!Argparser_load_snapshot(&parser, blob, size) && jobs(&parser) == 4);
+    CHECK(run_inits == 3);
+    CHECK(parse(&parser, stop) == ARG_ERROR_NONE);
+    CHECK(!Argparser_load_snapshot(&parser, blob, size) && jobs(&parser) == 4);
+    CHECK(run_inits == 4);
+    free(blob);
+
+    /* A global option added in between drops them */
+    Argparser_reset(&parser);
+    CHECK(!Argparser_add_argument(&parser, 'g', "global", ARG_BOOL));
+    const char *const run_global[] = {"sub", "run", "-g", "-j", "6", NULL};
+    CHECK(parse(&parser, run_global) == ARG_ERROR_NONE && jobs(&parser) == 6);
+    CHECK(run_inits == 5);
+
+    /* A subcommand whose init failed starts over */
+    const char *const bad[] = {"sub", "bad", NULL};
+    CHECK(parse(&parser, bad) == ARG_ERROR_COMMAND_SETUP);
+    CHECK(parse(&parser, bad) == ARG_ERROR_COMMAND_SETUP);
+    CHECK(bad_inits == 2);
+    CHECK(parse(&parser, run4) == ARG_ERROR_NONE && run_inits == 6);
+
+    /* Deinit with the options put aside */
+    Argparser_reset(&parser);
+    CHECK(parser.num_opts == num_global_opts + 1);
+    Argparser_deinit(&parser);
+    return CHECK_EXIT();
+}